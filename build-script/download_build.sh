@@ -112,6 +112,13 @@ if [ "$MAJOR_VERSION" -gt 6 ] || ([ "$MAJOR_VERSION" -eq 6 ] && [ "$MINOR_VERSIO
     xz -f linux-${KERNEL_VERSION}-v8+/drivers/gpu/drm/panel/panel-dsi-mt.ko
 fi
 
+# The trace events both panel drivers link against, only in motivo-6.6.y.patch
+TRACE_KO=drivers/gpu/drm/panel/panel-motivo-trace.ko
+if [ -f linux-${KERNEL_VERSION}-v8+/${TRACE_KO} ]; then
+    xz -f linux-${KERNEL_VERSION}-v7l+/${TRACE_KO}
+    xz -f linux-${KERNEL_VERSION}-v8+/${TRACE_KO}
+fi
+
 echo "!!!  Creating archive  !!!"
 rm -rf modules-rpi-${KERNEL_VERSION}-motivo/
 mkdir -p modules-rpi-${KERNEL_VERSION}-motivo/boot/overlays
@@ -123,10 +130,16 @@ cp linux-${KERNEL_VERSION}-v7l+/arch/arm/boot/dts/overlays/motivo*.dtbo modules-
 cp linux-${KERNEL_VERSION}-v7l+/arch/arm/boot/dts/overlays/es9039q2m*.dtbo modules-rpi-${KERNEL_VERSION}-motivo/boot/overlays
 cp linux-${KERNEL_VERSION}-v7l+/drivers/gpu/drm/panel/panel-ilitek-ili9881c.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v7l+/kernel/drivers/gpu/drm/panel/
 cp linux-${KERNEL_VERSION}-v7l+/drivers/gpu/drm/panel/panel-dsi-mt.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v7l+/kernel/drivers/gpu/drm/panel/
+if [ -f linux-${KERNEL_VERSION}-v7l+/${TRACE_KO}.xz ]; then
+    cp linux-${KERNEL_VERSION}-v7l+/${TRACE_KO}.xz modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v7l+/kernel/drivers/gpu/drm/panel/
+fi
 cp linux-${KERNEL_VERSION}-v7l+/drivers/gpu/drm/drm_panel_orientation_quirks.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v7l+/kernel/drivers/gpu/drm/
 cp linux-${KERNEL_VERSION}-v7l+/sound/usb/snd-usb-audio.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v7l+/kernel/sound/usb/
 cp linux-${KERNEL_VERSION}-v8+/drivers/gpu/drm/panel/panel-ilitek-ili9881c.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v8+/kernel/drivers/gpu/drm/panel/
 cp linux-${KERNEL_VERSION}-v8+/drivers/gpu/drm/panel/panel-dsi-mt.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v8+/kernel/drivers/gpu/drm/panel/
+if [ -f linux-${KERNEL_VERSION}-v8+/${TRACE_KO}.xz ]; then
+    cp linux-${KERNEL_VERSION}-v8+/${TRACE_KO}.xz modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v8+/kernel/drivers/gpu/drm/panel/
+fi
 cp linux-${KERNEL_VERSION}-v8+/drivers/gpu/drm/drm_panel_orientation_quirks.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v8+/kernel/drivers/gpu/drm/
 cp linux-${KERNEL_VERSION}-v8+/sound/usb/snd-usb-audio.ko* modules-rpi-${KERNEL_VERSION}-motivo/lib/modules/${KERNEL_VERSION}-v8+/kernel/sound/usb/
 tar -czvf modules-rpi-${KERNEL_VERSION}-motivo.tar.gz modules-rpi-${KERNEL_VERSION}-motivo/ --owner=0 --group=0
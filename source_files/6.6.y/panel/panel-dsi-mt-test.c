@@ -0,0 +1,641 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit suite for panel-dsi-mt. It is included at the end of the driver, so
+ * it binds the real probe and runs the DRM callbacks, init tables and
+ * retries against the fake host of panel-motivo-test.h, once for each
+ * compatible in mtdsi_of_match.
+ *
+ *   ./tools/testing/kunit/kunit.py run --kunitconfig=drivers/gpu/drm/panel
+ */
+#include <linux/firmware.h>
+#include <linux/vmalloc.h>
+
+#include "panel-motivo-test.h"
+
+static const void *mtdsi_test_gen_params(const void *prev, char *desc)
+{
+	return motivo_test_next_id(prev, desc, mtdsi_of_match);
+}
+
+static const struct panel_desc *mtdsi_test_match_desc(struct mipi_dsi_device *dsi)
+{
+	return motivo_test_match_data();
+}
+
+// As the overlays list it after "motivo,auto"
+static const struct panel_desc *mtdsi_test_auto_fallback(struct device_node *np)
+{
+	return &mt1280800a_desc;
+}
+
+// The module IDs of the variants in mtdsi_variants, as an overlay lists them
+static const u8 mtdsi_test_module_ids[][3] = {
+	{ 0x0a, 0x0b, 0x01 },
+	{ 0x0a, 0x0b, 0x02 },
+};
+
+static int mtdsi_test_variant_id(struct device *dev, unsigned int i, u8 *id)
+{
+	memcpy(id, mtdsi_test_module_ids[i], sizeof(mtdsi_test_module_ids[i]));
+
+	return 0;
+}
+
+// What motivo/<variant>.bin would hold, served by mtdsi_test_request_script()
+static struct {
+	const u8 *data;
+	size_t size;
+} mtdsi_test_fw;
+
+static int mtdsi_test_request_script(const struct firmware **fw,
+				     const char *name, struct device *dev)
+{
+	struct firmware *f;
+	void *data;
+
+	if (!mtdsi_test_fw.data)
+		return -ENOENT;
+
+	// Freed by release_firmware() as a directly loaded image
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	data = vmalloc(mtdsi_test_fw.size);
+	if (!f || !data) {
+		kfree(f);
+		vfree(data);
+		return -ENOMEM;
+	}
+
+	memcpy(data, mtdsi_test_fw.data, mtdsi_test_fw.size);
+	f->data = data;
+	f->size = mtdsi_test_fw.size;
+	*fw = f;
+
+	return 0;
+}
+
+static int mtdsi_test_init(struct kunit *test)
+{
+	kunit_activate_static_stub(test, mtdsi_match_desc, mtdsi_test_match_desc);
+	kunit_activate_static_stub(test, mtdsi_auto_fallback,
+				   mtdsi_test_auto_fallback);
+
+	return motivo_test_init(test, "panel-dsi-mt-test", mtdsi_probe);
+}
+
+static void mtdsi_test_exit(struct kunit *test)
+{
+	motivo_test_exit(test, mtdsi_remove);
+}
+
+static void mtdsi_test_on(struct kunit *test, const char *what)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	KUNIT_EXPECT_EQ(test, motivo_test_on(test, &ctx->base, what), 0);
+
+	KUNIT_EXPECT_EQ(test, ctx->state, MTDSI_STATE_ON);
+	KUNIT_EXPECT_EQ(test, ctx->health, MTDSI_HEALTH_OK);
+	KUNIT_EXPECT_EQ(test, h->page, 0);
+	KUNIT_EXPECT_TRUE(test, h->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+}
+
+static void mtdsi_test_off(struct kunit *test, const char *what)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	motivo_test_off(test, &ctx->base, what);
+
+	KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+	KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_SLEEP);
+}
+
+// Drop the panel out of standby, so the next power-up is a cold one
+static void mtdsi_test_cold(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	mutex_lock(&ctx->lock);
+	mtdsi_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+	motivo_test_hw_reset(h);
+}
+
+// Each vendor register holds what the last init write to it left there
+static void mtdsi_test_expect_regs(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	const u8 *op;
+	u8 page = 0;
+
+	for (op = ctx->init_cmds; op[0] != MTDSI_OP_END; op = mtdsi_op_next(op)) {
+		if (mtdsi_is_switch_page(op))
+			page = op[5];
+		else if (page && page < MOTIVO_TEST_PAGES && mtdsi_is_reg_write(op) &&
+			 mtdsi_last_write(op, page))
+			KUNIT_EXPECT_EQ(test, h->regs[page][op[2]], op[3]);
+	}
+}
+
+static void mtdsi_test_power_cycle(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+
+	mtdsi_test_on(test, "power on");
+	KUNIT_EXPECT_GT(test, h->writes, 0);
+	KUNIT_EXPECT_EQ(test, h->failures, 0);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// A modeset within the autosuspend delay wakes the panel without an init
+static void mtdsi_test_standby(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	unsigned int cold;
+
+	// As with motivo,standby-ms
+	ctx->standby_ok = true;
+
+	mtdsi_test_on(test, "cold on");
+	cold = h->writes;
+	mtdsi_test_off(test, "to standby");
+
+	mtdsi_test_on(test, "warm on");
+	KUNIT_EXPECT_LT(test, h->writes, cold);
+	KUNIT_EXPECT_EQ(test, h->page_switches, 0);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// System sleep comes before DRM's unprepare, which must then power off
+static void mtdsi_test_suspend(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	ctx->standby_ok = true;
+
+	mtdsi_test_on(test, "power on");
+	KUNIT_EXPECT_EQ(test, mtdsi_suspend(&h->dsi->dev), 0);
+	mtdsi_test_off(test, "suspend commit");
+	KUNIT_EXPECT_FALSE(test, ctx->standby);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	KUNIT_EXPECT_EQ(test, mtdsi_resume(&h->dsi->dev), 0);
+
+	mtdsi_test_on(test, "resume commit");
+	mtdsi_test_off(test, "to standby");
+	KUNIT_EXPECT_TRUE(test, ctx->standby);
+	KUNIT_EXPECT_EQ(test, mtdsi_suspend(&h->dsi->dev), 0);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	KUNIT_EXPECT_EQ(test, mtdsi_resume(&h->dsi->dev), 0);
+}
+
+// A write failing twice is retried within the budget, nothing is lost
+static void mtdsi_test_retry(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+
+	h->fail_at = 10;
+	h->fail_count = RETRY_CMD - 1;
+	h->fail_err = -EIO;
+
+	mtdsi_test_on(test, "power on, retried");
+	KUNIT_EXPECT_EQ(test, h->failures, RETRY_CMD - 1);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// A callback wanting the lock stops a recovery, which requeues itself
+static void mtdsi_test_recovery_yield(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	mtdsi_test_on(test, "power on");
+
+	mutex_lock(&ctx->lock);
+	mtdsi_fail(ctx, -EIO);
+	mutex_unlock(&ctx->lock);
+	cancel_delayed_work_sync(&ctx->recovery_work);
+
+	WRITE_ONCE(ctx->recovery_yield, true);
+	mtdsi_recovery_work(&ctx->recovery_work.work);
+	WRITE_ONCE(ctx->recovery_yield, false);
+	KUNIT_EXPECT_EQ(test, ctx->health, MTDSI_HEALTH_FAILED);
+	KUNIT_EXPECT_EQ(test, ctx->recovery_failures, 0);
+	KUNIT_EXPECT_TRUE(test, delayed_work_pending(&ctx->recovery_work));
+
+	// The requeued run brings the panel back on
+	cancel_delayed_work_sync(&ctx->recovery_work);
+	mtdsi_recovery_work(&ctx->recovery_work.work);
+	KUNIT_EXPECT_EQ(test, ctx->health, MTDSI_HEALTH_OK);
+	KUNIT_EXPECT_EQ(test, ctx->state, MTDSI_STATE_ON);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// A controller without auto-increment gets single writes from the first burst on
+static void mtdsi_test_burst_fallback(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	h->no_burst = true;
+
+	mtdsi_test_on(test, "no auto-increment");
+	KUNIT_EXPECT_EQ(test, ctx->burst, MTDSI_BURST_BROKEN);
+	mtdsi_test_expect_regs(test);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// An HS init the host cannot send is replayed in LP, and stays in LP
+static void mtdsi_test_hs_fallback(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	ctx->init_hs = true;
+	h->fail_hs_long = true;
+
+	mtdsi_test_on(test, "HS init refused");
+	KUNIT_EXPECT_GT(test, h->failures, 0);
+	KUNIT_EXPECT_FALSE(test, ctx->init_hs);
+	mtdsi_test_expect_regs(test);
+	mtdsi_test_off(test, "power off");
+	mtdsi_test_cold(test);
+
+	mtdsi_test_on(test, "LP init");
+	KUNIT_EXPECT_EQ(test, h->failures, 0);
+
+	mtdsi_test_off(test, "power off");
+}
+
+static const u8 mtdsi_test_script_cmds[] = {
+	_INIT_SWITCH_PAGE_CMD(0x01),
+	_INIT_DCS_CMD(0x30, 0x5a),
+	_INIT_DCS_CMD(0x31, 0xa5),
+	_INIT_SWITCH_PAGE_CMD(0x00),
+	_INIT_DCS_CMD(MIPI_DCS_EXIT_SLEEP_MODE),
+	_INIT_DELAY_CMD(120),
+	_INIT_DCS_CMD(MIPI_DCS_SET_DISPLAY_ON),
+	_INIT_END
+};
+
+// Load @size bytes of @fw as motivo/<variant>.bin, dropping a script loaded before
+static void mtdsi_test_load_script(struct mtdsi *ctx, const u8 *fw, size_t size)
+{
+	if (ctx->init_cmds != ctx->desc->init_cmds)
+		devm_kfree(&ctx->dsi->dev, ctx->init_cmds);
+
+	mtdsi_test_fw.data = fw;
+	mtdsi_test_fw.size = size;
+	mtdsi_load_init_script(ctx);
+	mtdsi_test_fw.data = NULL;
+}
+
+static void mtdsi_test_seal_script(u8 *fw, size_t len)
+{
+	struct mtdsi_fw_header *hdr = (struct mtdsi_fw_header *)fw;
+
+	hdr->length = cpu_to_le32(len);
+	hdr->crc = cpu_to_le32(crc32_le(~0, fw + sizeof(*hdr), len) ^ ~0);
+}
+
+// A well-formed script replaces the built-in table, a damaged one is refused
+static void mtdsi_test_script(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	size_t len = sizeof(mtdsi_test_script_cmds);
+	struct mtdsi_fw_header *hdr;
+	size_t size;
+	u8 *fw, *cmds;
+
+	size = sizeof(*hdr) + len;
+	fw = kunit_kzalloc(test, size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, fw);
+	hdr = (struct mtdsi_fw_header *)fw;
+	cmds = fw + sizeof(*hdr);
+
+	hdr->magic = cpu_to_le32(MTDSI_FW_MAGIC);
+	hdr->version = cpu_to_le16(MTDSI_FW_VERSION);
+	memcpy(cmds, mtdsi_test_script_cmds, len);
+	mtdsi_test_seal_script(fw, len);
+
+	kunit_activate_static_stub(test, mtdsi_request_script,
+				   mtdsi_test_request_script);
+
+	mtdsi_test_load_script(ctx, fw, size);
+	KUNIT_ASSERT_PTR_NE(test, ctx->init_cmds, ctx->desc->init_cmds);
+	KUNIT_EXPECT_EQ(test, memcmp(ctx->init_cmds, cmds, len), 0);
+
+	mtdsi_test_on(test, "scripted init");
+	KUNIT_EXPECT_EQ(test, h->regs[1][0x30], 0x5a);
+	KUNIT_EXPECT_EQ(test, h->regs[1][0x31], 0xa5);
+	mtdsi_test_off(test, "power off");
+
+	// Cut short: the length no longer matches the file
+	mtdsi_test_load_script(ctx, fw, size - 1);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->init_cmds, ctx->desc->init_cmds);
+
+	// A flipped bit fails the CRC
+	cmds[3] ^= 0x01;
+	mtdsi_test_load_script(ctx, fw, size);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->init_cmds, ctx->desc->init_cmds);
+	cmds[3] ^= 0x01;
+
+	hdr->version = cpu_to_le16(MTDSI_FW_VERSION + 1);
+	mtdsi_test_load_script(ctx, fw, size);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->init_cmds, ctx->desc->init_cmds);
+	hdr->version = cpu_to_le16(MTDSI_FW_VERSION);
+
+	// Sealed, but with an unknown opcode and then without its terminator
+	cmds[0] = 0x7f;
+	mtdsi_test_seal_script(fw, len);
+	mtdsi_test_load_script(ctx, fw, size);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->init_cmds, ctx->desc->init_cmds);
+	cmds[0] = mtdsi_test_script_cmds[0];
+
+	mtdsi_test_seal_script(fw, len - 1);
+	mtdsi_test_load_script(ctx, fw, size - 1);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->init_cmds, ctx->desc->init_cmds);
+}
+
+// Reset and init are done when prepare returns, enable sends no init
+static void mtdsi_test_prepare_sync(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	unsigned int prepared;
+
+	KUNIT_EXPECT_EQ(test, drm_panel_prepare(&ctx->base), 0);
+	prepared = h->writes;
+	KUNIT_EXPECT_GE(test, prepared, ctx->init_xfers);
+	KUNIT_EXPECT_EQ(test, drm_panel_enable(&ctx->base), 0);
+	KUNIT_EXPECT_LT(test, h->writes - prepared, ctx->init_xfers);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// Panels on DSI0 and DSI1 come up independently of each other
+static void mtdsi_test_dual(struct kunit *test)
+{
+	struct motivo_test_host *h0 = test->priv, *h1;
+	struct mtdsi *ctx0 = mipi_dsi_get_drvdata(h0->dsi), *ctx1;
+
+	h1 = motivo_test_host_init(test, "panel-dsi-mt-test-dsi1");
+	KUNIT_ASSERT_NOT_NULL(test, h1);
+	motivo_test_probe(test, h1, mtdsi_probe);
+	ctx1 = mipi_dsi_get_drvdata(h1->dsi);
+
+	motivo_test_reset_counts(h0);
+	motivo_test_reset_counts(h1);
+
+	KUNIT_EXPECT_EQ(test, drm_panel_prepare(&ctx0->base), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_prepare(&ctx1->base), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_enable(&ctx0->base), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_enable(&ctx1->base), 0);
+	KUNIT_EXPECT_EQ(test, h0->writes, h1->writes);
+	KUNIT_EXPECT_TRUE(test, h1->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+
+	KUNIT_EXPECT_EQ(test, drm_panel_disable(&ctx1->base), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_unprepare(&ctx1->base), 0);
+	mtdsi_test_off(test, "DSI0 off");
+
+	motivo_test_remove(h1, mtdsi_remove);
+}
+
+// A pruned write heading a register run leaves the rest of the run sent
+static void mtdsi_test_prune_run(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	const u8 *op, *next;
+	unsigned int i = 0;
+	u8 page = 0;
+
+	for (op = ctx->init_cmds; op[0] != MTDSI_OP_END; op = next, i++) {
+		next = mtdsi_op_next(op);
+		if (mtdsi_is_switch_page(op))
+			page = op[5];
+		else if (page && mtdsi_is_reg_write(op) && mtdsi_is_reg_write(next) &&
+			 next[2] == op[2] + 1 && mtdsi_last_write(next, page))
+			break;
+	}
+	if (op[0] == MTDSI_OP_END)
+		kunit_skip(test, "init table has no register run");
+
+	ctx->prune = true;
+	mtdsi_test_on(test, "learning init");
+	KUNIT_ASSERT_TRUE(test, ctx->prune_learned);
+	mtdsi_test_off(test, "power off");
+	mtdsi_test_cold(test);
+
+	// Only the first write of the run restores a reset value
+	bitmap_zero(ctx->prune_map, ctx->prune_ops);
+	__set_bit(i, ctx->prune_map);
+	h->regs[page][next[2]] = ~next[3];
+
+	mtdsi_test_on(test, "pruned init");
+	KUNIT_EXPECT_EQ(test, ctx->pruned, 1);
+	KUNIT_EXPECT_EQ(test, h->regs[page][next[2]], next[3]);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// A module ID naming B under an A overlay keeps A, on the link it attached
+static void mtdsi_test_auto_override(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	if (!ctx->detect_pending)
+		kunit_skip(test, "not a motivo,auto panel");
+
+	kunit_activate_static_stub(test, mtdsi_variant_id, mtdsi_test_variant_id);
+	memcpy(&h->regs[0][MTDSI_DCS_READ_ID1], mtdsi_test_module_ids[1], 3);
+
+	mtdsi_test_on(test, "identified as B");
+	KUNIT_EXPECT_FALSE(test, ctx->detect_pending);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->desc, &mt1280800a_desc);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->init_cmds, mt1280800a_desc.init_cmds);
+
+	mtdsi_test_off(test, "power off");
+}
+
+/*
+ * The A module ID selects A. Without a fallback, an unknown ID leaves the
+ * panel undriven, and so does the B ID, as B needs another link than the
+ * A one attached at probe.
+ */
+static void mtdsi_test_auto_identify(struct kunit *test)
+{
+	static const u8 unknown[] = { 0x0a, 0x0b, 0xff };
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	u8 *id = &h->regs[0][MTDSI_DCS_READ_ID1];
+
+	if (!ctx->detect_pending)
+		kunit_skip(test, "not a motivo,auto panel");
+
+	kunit_activate_static_stub(test, mtdsi_variant_id, mtdsi_test_variant_id);
+	ctx->fallback = NULL;
+
+	memcpy(id, unknown, sizeof(unknown));
+	KUNIT_EXPECT_EQ(test, drm_panel_prepare(&ctx->base), -ENODEV);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	KUNIT_EXPECT_TRUE(test, ctx->detect_pending);
+	motivo_test_hw_reset(h);
+
+	memcpy(id, mtdsi_test_module_ids[1], 3);
+	KUNIT_EXPECT_EQ(test, drm_panel_prepare(&ctx->base), -ENODEV);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	motivo_test_hw_reset(h);
+
+	memcpy(id, mtdsi_test_module_ids[0], 3);
+	mtdsi_test_on(test, "identified as A");
+	KUNIT_EXPECT_FALSE(test, ctx->detect_pending);
+	KUNIT_EXPECT_PTR_EQ(test, ctx->desc, &mt1280800a_desc);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// Timings trimmed to the controller minimums shorten a cold power-up
+static void mtdsi_test_timings(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	unsigned int slow;
+
+	mtdsi_test_on(test, "default timings");
+	slow = h->delay_ms;
+	mtdsi_test_off(test, "power off");
+
+	mtdsi_test_cold(test);
+
+	ctx->timing = (struct mtdsi_timings) {
+		.reset_low_ms = 1,
+		.reset_recovery_us = CMD_DELAY * 1000,
+		.sleep_out_ms = CMD_DELAY,
+		.sleep_in_ms = 20,
+		.retry_delay_ms = 10,
+	};
+
+	mtdsi_test_on(test, "trimmed timings");
+	KUNIT_EXPECT_LT(test, h->delay_ms, slow);
+
+	mtdsi_test_off(test, "power off");
+}
+
+// Shutdown takes a lit panel down, the DRM disable after it sends nothing
+static void mtdsi_test_shutdown(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	ktime_t start;
+
+	mtdsi_test_on(test, "power on");
+
+	motivo_test_reset_counts(h);
+	start = ktime_get();
+	mtdsi_shutdown(h->dsi);
+	motivo_test_report(test, h, "shutdown", ktime_us_delta(ktime_get(), start));
+
+	KUNIT_EXPECT_EQ(test, ctx->state, MTDSI_STATE_OFF);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+	KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_SLEEP);
+	KUNIT_EXPECT_LE(test, h->delay_ms, ctx->timing.sleep_in_ms);
+
+	motivo_test_reset_counts(h);
+	KUNIT_EXPECT_EQ(test, drm_panel_disable(&ctx->base), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_unprepare(&ctx->base), 0);
+	KUNIT_EXPECT_EQ(test, h->writes, 0);
+}
+
+// A flat CRTC LUT puts every tap at the VP0/VN0 value, dropping it restores the curve
+static void mtdsi_test_gamma_lut(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(h->dsi);
+	static struct drm_color_lut lut[256];
+	u8 def[2 * MOTIVO_GAMMA_TAPS];
+	struct drm_connector_state *conn_state;
+	struct drm_connector *connector;
+	struct drm_property_blob *blob;
+	struct drm_crtc_state *crtc_state;
+	struct drm_crtc *crtc;
+	unsigned int i;
+
+	if (!mtdsi_gamma_defaults(ctx, def))
+		kunit_skip(test, "init table leaves the gamma alone");
+
+	connector = kunit_kzalloc(test, sizeof(*connector), GFP_KERNEL);
+	conn_state = kunit_kzalloc(test, sizeof(*conn_state), GFP_KERNEL);
+	crtc = kunit_kzalloc(test, sizeof(*crtc), GFP_KERNEL);
+	crtc_state = kunit_kzalloc(test, sizeof(*crtc_state), GFP_KERNEL);
+	blob = kunit_kzalloc(test, sizeof(*blob), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, connector);
+	KUNIT_ASSERT_NOT_NULL(test, conn_state);
+	KUNIT_ASSERT_NOT_NULL(test, crtc);
+	KUNIT_ASSERT_NOT_NULL(test, crtc_state);
+	KUNIT_ASSERT_NOT_NULL(test, blob);
+
+	blob->data = lut;
+	blob->length = sizeof(lut);
+	crtc_state->gamma_lut = blob;
+	crtc->state = crtc_state;
+	conn_state->crtc = crtc;
+	connector->state = conn_state;
+	ctx->connector = connector;
+	ctx->gamma_crtc = true;
+
+	mtdsi_test_on(test, "flat LUT");
+	for (i = 0; i < MOTIVO_GAMMA_TAPS; i++) {
+		KUNIT_EXPECT_EQ(test, h->regs[1][MOTIVO_GAMMA_POS + i],
+				def[MOTIVO_GAMMA_TAPS - 1]);
+		KUNIT_EXPECT_EQ(test, h->regs[1][MOTIVO_GAMMA_NEG + i],
+				def[2 * MOTIVO_GAMMA_TAPS - 1]);
+	}
+	mtdsi_test_off(test, "power off");
+
+	crtc_state->gamma_lut = NULL;
+	mtdsi_test_on(test, "no LUT");
+	for (i = 0; i < MOTIVO_GAMMA_TAPS; i++) {
+		KUNIT_EXPECT_EQ(test, h->regs[1][MOTIVO_GAMMA_POS + i], def[i]);
+		KUNIT_EXPECT_EQ(test, h->regs[1][MOTIVO_GAMMA_NEG + i],
+				def[MOTIVO_GAMMA_TAPS + i]);
+	}
+	mtdsi_test_off(test, "power off");
+	ctx->connector = NULL;
+}
+
+static struct kunit_case mtdsi_test_cases[] = {
+	MOTIVO_TEST_CASES(mtdsi),
+	KUNIT_CASE_PARAM(mtdsi_test_retry, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_recovery_yield, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_burst_fallback, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_hs_fallback, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_script, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_prepare_sync, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_prune_run, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_auto_override, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_auto_identify, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_dual, mtdsi_test_gen_params),
+	KUNIT_CASE_PARAM(mtdsi_test_gamma_lut, mtdsi_test_gen_params),
+	{}
+};
+
+static struct kunit_suite mtdsi_test_suite = {
+	.name = "panel-dsi-mt",
+	.init = mtdsi_test_init,
+	.exit = mtdsi_test_exit,
+	.test_cases = mtdsi_test_cases,
+};
+kunit_test_suite(mtdsi_test_suite);
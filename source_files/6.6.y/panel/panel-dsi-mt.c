@@ -26,23 +26,56 @@
  * This module is rewritten from panel-ilitek modules template
  */
 
+#include <kunit/static_stub.h>
+
+#include <linux/bitmap.h>
+#include <linux/build_bug.h>
+#include <linux/crc32.h>
 #include <linux/delay.h>
+#include <linux/firmware.h>
 #include <linux/gpio/consumer.h>
+#include <linux/ktime.h>
+#include <linux/limits.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
+#include <linux/pm_runtime.h>
 #include <linux/regulator/consumer.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
 
 #include <drm/drm_connector.h>
 #include <drm/drm_crtc.h>
 #include <drm/drm_mipi_dsi.h>
 #include <drm/drm_panel.h>
+#include <drm/drm_probe_helper.h>
 
 #include <video/mipi_display.h>
 
+#include "panel-motivo.h"
+#include "panel-motivo-trace.h"
+
 #define RETRY_CMD	3		// Usually if it doesn't recover after the first or second failure, it won't recover at all.
 #define RETRY_DELAY	120		// Retry wait time for the drm vc4 host transfer.
+#define RETRY_BUDGET	500		// Retry backoff a whole prepare, enable or disable may spend.
+#define BURST_MAX	16		// Registers per coalesced write, keeps the vc4 command FIFO happy.
+#define SLEEP_OUT_DELAY	120		// Sleep-out to display-on, matches the init tables.
+#define DISPLAY_ON_DELAY	20	// Display-on settle time, matches the init tables.
+#define SLEEP_IN_DELAY	150		// Sleep-in to power off.
+#define CMD_DELAY	5		// Controller busy time after sleep-in/out or reset.
+#define SLEEP_GUARD	120		// Least time between sleep-in, sleep-out, reset and the next of them.
+#define RESET_DELAY	10		// Reset release to first command.
+#define RESET_LOW	50		// Reset pulse width.
+
+#define RECOVERY_DELAY	500		// First recovery attempt after a failure, doubled per retry.
+#define RECOVERY_DELAY_MAX	10000	// Recovery backoff ceiling.
+#define ESD_CHECK_MIN	1000		// Shortest power mode check period, each check is an LP read.
+
+#define MTDSI_POWER_MODE_BOOSTER	BIT(7)	// DCS 0Ah: booster voltage up
+#define MTDSI_POWER_MODE_ALIVE	(MIPI_DCS_POWER_MODE_SLEEP | MIPI_DCS_POWER_MODE_DISPLAY)
+#define MTDSI_POWER_MODE_LIT	(MTDSI_POWER_MODE_ALIVE | MIPI_DCS_POWER_MODE_NORMAL)
 
-static atomic_t errorFlag = ATOMIC_INIT(0); // When broken atomic modeset userspace detected, reset from here.
+#define MTDSI_SHADOW_PAGES	8	// Command pages with a register shadow
 
 
 /*
@@ -64,8 +97,56 @@ struct panel_desc {
 
 	unsigned long mode_flags;
 	enum mipi_dsi_pixel_format format;
-	const struct panel_init_cmd *init_cmds;
+	const u8 *init_cmds;
 	unsigned int lanes;
+
+	/**
+	 * @init_hs: send the init sequence in HS mode instead of LP escape
+	 * mode. Off for all panels so far, "motivo,init-hs" opts in.
+	 */
+	bool init_hs;
+};
+
+// Power sequence delays, the defines above unless the DT overrides them
+struct mtdsi_timings {
+	unsigned int reset_low_ms;
+	unsigned int reset_recovery_us;
+	unsigned int sleep_out_ms;
+	unsigned int sleep_in_ms;
+	unsigned int retry_delay_ms;
+};
+
+/*
+ * Power-on progress of the controller. prepare() and enable() only issue the
+ * transitions the panel has not received yet, whichever of them sends it.
+ */
+enum mtdsi_state {
+	MTDSI_STATE_OFF,	// Rail off or reset asserted
+	MTDSI_STATE_SLEEP,	// Out of reset, sleeping with the display off
+	MTDSI_STATE_AWAKE,	// Sleep-out sent and its delay served
+	MTDSI_STATE_ON,		// Display-on sent
+};
+
+enum mtdsi_health {
+	MTDSI_HEALTH_OK,
+	MTDSI_HEALTH_FAILED,	// Waiting for the recovery worker
+	MTDSI_HEALTH_RECOVERING,
+};
+
+enum mtdsi_burst {
+	MTDSI_BURST_UNTESTED,
+	MTDSI_BURST_OK,
+	MTDSI_BURST_BROKEN,
+};
+
+/*
+ * What each register of the command pages was last set to, so a runtime
+ * change only sends the registers that differ. Dropped whenever a reset
+ * or an unknown panel state makes it stale.
+ */
+struct mtdsi_shadow {
+	u8 val[MTDSI_SHADOW_PAGES][256];
+	DECLARE_BITMAP(valid, MTDSI_SHADOW_PAGES * 256);
 };
 
 struct mtdsi {
@@ -73,40 +154,122 @@ struct mtdsi {
 	struct mipi_dsi_device *dsi;
 
 	const struct panel_desc *desc;
+	const u8 *init_cmds;		// Built-in table or the loaded init script
+
+	int page;			// Current command page, -1 when unknown
+	bool fresh;			// Controller untouched since its hardware reset
+	struct mtdsi_shadow shadow;
+
+	bool prune;			// Skip init writes that restore reset values
+	bool prune_verify;		// Read the registers back after a pruned init
+	bool prune_learned;
+	unsigned long *prune_map;	// Init ops found to restore a reset value
+	unsigned int prune_ops;		// Ops covered by prune_map
+	unsigned int pruned;		// Writes skipped by the last init
+	unsigned int page_skips;	// Page switches saved by tracking the page
+	bool detect_pending;		// "motivo,auto" panel not identified yet
+	const struct panel_desc *fallback;	// Variant listed after "motivo,auto", if any
+	bool no_page3;			// Controller revision without command page 3
+	struct drm_connector *connector;	// Held from get_modes, for the re-probe and the CRTC LUT
+	struct work_struct hotplug_work;
 
 	enum drm_panel_orientation orientation;
 	struct regulator *power;
 	struct gpio_desc *reset;
-};
 
-enum dsi_cmd_type {
-	INIT_DCS_CMD,
-	DELAY_CMD,
+	bool init_hs;		// Cleared for good once an HS init sequence failed
+	s64 init_us[2];		// Last init sequence duration, indexed by HS mode
+
+	enum mtdsi_state state;
+	bool poll_ready;	// Poll the power mode instead of serving fixed delays
+	ktime_t sleep_in_ok;	// Earliest sleep-in, SLEEP_GUARD after the last sleep-out
+	ktime_t sleep_out_ok;	// Earliest sleep-out, SLEEP_GUARD after the last sleep-in or reset
+	struct mtdsi_timings timing;
+	ktime_t retry_deadline;	// End of the retry budget of the running sequence
+	enum mtdsi_burst burst;	// Whether the controller auto-increments on long writes
+	unsigned int init_xfers;	// DSI transfers used by the last init sequence
+
+	struct mutex lock;		// Serialises the DRM callbacks and the workers
+	bool enabled;			// What DRM last asked the panel to be
+	bool powered;			// Regulator enabled by prepare
+	bool handoff;			// Panel may have been lit by the firmware
+	bool standby;			// Powered, initialised and asleep between unprepare and prepare
+	bool standby_ok;		// "motivo,standby-ms" asks for the standby above
+	bool suspended;			// System sleep, see mtdsi_suspend()
+	bool active;			// Runtime PM reference held from prepare to unprepare
+
+	enum mtdsi_health health;
+	struct delayed_work recovery_work;
+	bool recovery_yield;		// A callback wants the lock, see mtdsi_lock_yield()
+	struct delayed_work esd_work;
+	unsigned int esd_period;	// ms between power mode checks, 0 when disabled
+	unsigned int recovery_delay;	// Current recovery backoff in ms
+	ktime_t failed_at;
+	unsigned int recoveries;
+	unsigned int recovery_failures;
+	s64 last_recovery_ms;		// Failure to recovered display of the last recovery
+
+	u8 gamma[2 * MOTIVO_GAMMA_TAPS];	// Positive then negative curve
+	bool gamma_set;			// Set through sysfs, written after every init
+	bool gamma_crtc;		// "motivo,gamma-from-crtc": fit the CRTC LUT onto the curve
+	bool gamma_lut_set;		// The CRTC had a LUT at the last enable
+	u32 gamma_lut[MOTIVO_GAMMA_TAPS];	// That LUT at the tap levels, see motivo_gamma_sample()
+	int cabc;			// CABC mode set through sysfs, -1 for the table's
 };
 
-struct panel_init_cmd {
-	enum dsi_cmd_type type;
-	size_t len;
-	const char *data;
+/*
+ * Init tables are one packed byte stream per panel: an opcode, the payload
+ * length and the payload, repeated until MTDSI_OP_END. The lengths are worked
+ * out by the compiler, which also refuses anything that does not fit its
+ * byte, so a table decodes to exactly the commands written in it.
+ */
+enum mtdsi_op {
+	MTDSI_OP_END,
+	MTDSI_OP_DCS,		// DCS write of the payload
+	MTDSI_OP_DELAY,		// Payload is a single delay in ms
 };
 
-#define _INIT_DCS_CMD(...) { \
-	.type = INIT_DCS_CMD, \
-	.len = sizeof((char[]){__VA_ARGS__}), \
-	.data = (char[]){__VA_ARGS__} }
+#define MTDSI_OP_HDR	2	// Opcode and length bytes
 
-#define _INIT_DELAY_CMD(...) { \
-	.type = DELAY_CMD,\
-	.len = sizeof((char[]){__VA_ARGS__}), \
-	.data = (char[]){__VA_ARGS__} }
+#define _INIT_DCS_LEN(...) \
+	(sizeof((u8[]){__VA_ARGS__}) + \
+	 BUILD_BUG_ON_ZERO(sizeof((u8[]){__VA_ARGS__}) > U8_MAX))
+
+#define _INIT_DCS_CMD(...) \
+	MTDSI_OP_DCS, _INIT_DCS_LEN(__VA_ARGS__), __VA_ARGS__
+
+#define _INIT_DELAY_CMD(ms) \
+	MTDSI_OP_DELAY, 1, (ms) + BUILD_BUG_ON_ZERO((ms) > U8_MAX)
+
+#define _INIT_END	MTDSI_OP_END
+
+/*
+ * Init scripts can be loaded from "motivo/<variant>.bin", <variant> being
+ * the entry of mtdsi_variants driving the panel, so a "motivo,auto" panel
+ * gets the script of the module it identified. The file is this header
+ * followed by an init stream in the format above; the built-in table is
+ * used when it is missing or does not validate.
+ */
+#define MTDSI_FW_MAGIC		0x4e49544d	// "MTIN"
+#define MTDSI_FW_VERSION	1
+#define MTDSI_FW_MAX		4096
+
+struct mtdsi_fw_header {
+	__le32 magic;
+	__le16 version;		// Format version, MTDSI_FW_VERSION
+	__le16 revision;	// Script revision, only reported
+	__le32 length;		// Bytes of init stream after the header
+	__le32 crc;		// CRC-32 of the init stream
+} __packed;
 
 /* MTDSI-specific commands, add new commands as you decode them */
 #define MTDSI_DCS_SWITCH_PAGE	0xFF
+#define MTDSI_DCS_READ_ID1	0xDA	// ID2 and ID3 follow
 
 #define _INIT_SWITCH_PAGE_CMD(page) \
 	_INIT_DCS_CMD(MTDSI_DCS_SWITCH_PAGE, 0x98, 0x81, (page))
 
-static const struct panel_init_cmd mt1280800a_init_cmd[] = {
+static const u8 mt1280800a_init_cmd[] = {
 	_INIT_DELAY_CMD(5),
 /*
 *	_INIT_SWITCH_PAGE_CMD(0x03),
@@ -200,7 +363,7 @@ static const struct panel_init_cmd mt1280800a_init_cmd[] = {
 	//PWM controlled by overlay
 	_INIT_DCS_CMD(0x55, 0x03), // Medium Setting of CABC/DBLC
 
-	{},
+	_INIT_END,
 };
 
 static const struct drm_display_mode mt1280800a_default_mode = {
@@ -243,7 +406,7 @@ static const struct panel_desc mt1280800a_desc = {
 	.init_cmds = mt1280800a_init_cmd,
 };
 
-static const struct panel_init_cmd mt1280800b_init_cmd[] = {
+static const u8 mt1280800b_init_cmd[] = {
 	_INIT_DELAY_CMD(5),
 	_INIT_SWITCH_PAGE_CMD(0x03),
 	//GIP_1
@@ -462,7 +625,7 @@ static const struct panel_init_cmd mt1280800b_init_cmd[] = {
 	//PWM controlled by overlay
 	_INIT_DCS_CMD(0x55, 0x01), // Conservative Setting of CABC/DBLC
 
-	{},
+	_INIT_END,
 };
 
 static const struct drm_display_mode mt1280800b_default_mode = {
@@ -510,385 +673,2123 @@ static inline struct mtdsi *to_mtdsi(struct drm_panel *panel)
 	return container_of(panel, struct mtdsi, base);
 }
 
-static int mtdsi_init_dcs_cmd(struct mtdsi *ctx)
+static void mtdsi_set_lpm(struct mtdsi *ctx, bool lpm)
 {
-	struct mipi_dsi_device *dsi = ctx->dsi;
-	struct drm_panel *panel = &ctx->base;
-	int i, err = 0, retry = 0;
-
-	if (ctx->desc->init_cmds) {
-		const struct panel_init_cmd *init_cmds = ctx->desc->init_cmds;
-
-		for (i = 0; init_cmds[i].len != 0; i++) {
-			const struct panel_init_cmd *cmd = &init_cmds[i];
-		do {
-			switch (cmd->type) {
-			case DELAY_CMD:
-				msleep(cmd->data[0]);
-				err = 0;
-				break;
-
-			case INIT_DCS_CMD:
-				err = mipi_dsi_dcs_write(dsi, cmd->data[0],
-							 cmd->len <= 1 ? NULL :
-							 &cmd->data[1],
-							 cmd->len - 1);
-				break;
+	if (lpm)
+		ctx->dsi->mode_flags |= MIPI_DSI_MODE_LPM;
+	else
+		ctx->dsi->mode_flags &= ~MIPI_DSI_MODE_LPM;
+}
 
-			default:
-				err = -EINVAL;
-			}
+static const u8 *mtdsi_op_next(const u8 *op)
+{
+	return op + MTDSI_OP_HDR + op[1];
+}
 
-			if (err) msleep(RETRY_DELAY);
-			++retry;
-			}
-			while (err && retry < RETRY_CMD);
+// Single-byte write to a register: opcode, length, register, value
+static bool mtdsi_is_reg_write(const u8 *op)
+{
+	return op[0] == MTDSI_OP_DCS && op[1] == 2;
+}
 
-			if (err < 0) {
-				dev_err(panel->dev,
-					"DSI: Failed to write init commands %u\n", i);
-				return err;
-			}
-		}
-	}
-	return 0;
+static bool mtdsi_is_switch_page(const u8 *op)
+{
+	return op[0] == MTDSI_OP_DCS && op[1] == 4 &&
+	       op[2] == MTDSI_DCS_SWITCH_PAGE;
 }
 
-static int mtdsi_switch_page(struct mipi_dsi_device *dsi, u8 page)
+/*
+ * Number of register writes starting at @cmd that can go out as one long
+ * write: single-byte writes to consecutive registers on a vendor page.
+ * Page 0 holds the standard DCS commands and is never coalesced.
+ */
+static unsigned int mtdsi_burst_len(struct mtdsi *ctx, const u8 *op,
+				    unsigned int i, u8 page, bool prune)
 {
-	int retry,ret;
-	const struct panel_init_cmd cmd = _INIT_SWITCH_PAGE_CMD(page);
+	const u8 *next = mtdsi_op_next(op);
+	unsigned int n = 1;
 
-    retry = 0;
-    do {
-	ret = mipi_dsi_dcs_write(dsi, cmd.data[0],
-				 cmd.len <= 1 ? NULL :
-				 &cmd.data[1],
-				 cmd.len - 1);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret) {
-		dev_err(&dsi->dev,
-			"DSI: Error switching panel controller page (%d)\n", ret);
-		return ret;
+	if (ctx->burst == MTDSI_BURST_BROKEN || page == 0 ||
+	    !mtdsi_is_reg_write(op))
+		return 1;
+
+	while (n < BURST_MAX && mtdsi_is_reg_write(next) && next[2] == op[2] + n &&
+	       !(prune && test_bit(i + n, ctx->prune_map))) {
+		next = mtdsi_op_next(next);
+		n++;
 	}
 
-	return 0;
+	return n;
 }
 
-static int mtdsi_enter_sleep_mode(struct mtdsi *ctx)
+// Start the retry budget of a prepare, enable or disable sequence
+static void mtdsi_retry_budget_start(struct mtdsi *ctx)
 {
-	struct mipi_dsi_device *dsi = ctx->dsi;
-	int retry,ret;
-
-	dsi->mode_flags &= ~MIPI_DSI_MODE_LPM;
+	ctx->retry_deadline = ktime_add_ms(ktime_get(), RETRY_BUDGET);
+}
 
-	// MIPI needs to return to the LP11 state before enabling all blocks inside the display
+/*
+ * Send one DCS write with up to RETRY_CMD attempts. A retry only happens
+ * while its backoff still fits in the sequence budget, so a dead panel
+ * fails the whole sequence in well under a second instead of backing off
+ * on every command of the table.
+ */
+static int mtdsi_dcs_write_retry(struct mtdsi *ctx, const u8 *data, size_t len)
+{
+	unsigned int retry;
+	ktime_t start;
+	int ret;
 
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_nop(ctx->dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(&dsi->dev, "DSI: Failed to return to the LP11 state prior sleep mode enter: %d\n", ret);
-//		return 0; //Do not error here yet. This is DSI transfer warmup.
+	for (retry = 1; ; retry++) {
+		start = ktime_get();
+		ret = mipi_dsi_dcs_write_buffer(ctx->dsi, data, len);
+		trace_motivo_panel_dcs_write(ctx->base.dev, ctx->page, data, len,
+					     ktime_to_ns(ktime_sub(ktime_get(), start)),
+					     ret < 0 ? ret : 0);
+		if (ret >= 0)
+			return 0;
+
+		if (retry >= RETRY_CMD ||
+		    ktime_after(ktime_add_ms(ktime_get(), ctx->timing.retry_delay_ms),
+				ctx->retry_deadline))
+			return ret;
+
+		trace_motivo_panel_retry(ctx->base.dev, data[0], retry,
+					 ctx->timing.retry_delay_ms, ret);
+		msleep(ctx->timing.retry_delay_ms);
 	}
+}
 
-	usleep_range(1000, 20000);
-
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_set_display_off(dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(&dsi->dev, "DSI: Failed to set display off: %d\n", ret);
-		return ret;
-	}
+static int mtdsi_dcs_cmd(struct mtdsi *ctx, u8 cmd)
+{
+	return mtdsi_dcs_write_retry(ctx, &cmd, 1);
+}
 
-	msleep(5);
+static int mtdsi_read_reg(struct mtdsi *ctx, u8 reg, u8 *val)
+{
+	int ret;
 
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_enter_sleep_mode(dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(&dsi->dev, "DSI: Failed to enter sleep mode: %d\n", ret);
+	ret = mipi_dsi_dcs_read(ctx->dsi, reg, val, 1);
+	if (ret < 0)
 		return ret;
-	}
 
-	return 0;
+	return ret == 1 ? 0 : -EIO;
 }
 
-static int mtdsi_disable(struct drm_panel *panel)
+/*
+ * Until a burst has been seen to land, each one is checked register by
+ * register. Only a burst that changes one of its registers tells anything,
+ * one that writes back what they already hold would pass either way.
+ */
+static int mtdsi_write_burst(struct mtdsi *ctx, const u8 *op, unsigned int n)
 {
-	struct mtdsi *ctx = to_mtdsi(panel);
+	struct mipi_dsi_device *dsi = ctx->dsi;
+	u8 buf[BURST_MAX + 1];
+	const u8 *next = op;
+	bool changes = false;
+	unsigned int i;
+	u8 val;
 	int ret;
 
-	ret = mtdsi_enter_sleep_mode(ctx);
-	if (ret < 0) {
-		dev_err(panel->dev, "DSI: Failed to set panel off: %d\n", ret);
-        atomic_set(&errorFlag, 1);
+	buf[0] = op[2];
+	buf[1] = op[3];
+	for (i = 1; i < n; i++) {
+		next = mtdsi_op_next(next);
+		buf[i + 1] = next[3];
+	}
+
+	if (ctx->burst == MTDSI_BURST_UNTESTED) {
+		for (i = 0; i < n; i++) {
+			if (mtdsi_read_reg(ctx, buf[0] + i, &val) < 0)
+				goto single;
+			changes |= val != buf[i + 1];
+		}
+	}
+
+	ret = mtdsi_dcs_write_retry(ctx, buf, n + 1);
+	ctx->init_xfers++;
+	if (ret < 0)
 		return ret;
+
+	if (ctx->burst == MTDSI_BURST_OK)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (mtdsi_read_reg(ctx, buf[0] + i, &val) < 0 || val != buf[i + 1])
+			goto single;
 	}
 
-	atomic_set(&errorFlag, 0);
+	if (changes)
+		ctx->burst = MTDSI_BURST_OK;
 
-	msleep(150);
+	return 0;
+
+single:
+	dev_warn(&dsi->dev, "DSI: Controller rejects multi-register writes, using single writes\n");
+	ctx->burst = MTDSI_BURST_BROKEN;
+
+	for (i = 0; i < n; i++, op = mtdsi_op_next(op)) {
+		ret = mtdsi_dcs_write_retry(ctx, op + MTDSI_OP_HDR, op[1]);
+		ctx->init_xfers++;
+		if (ret < 0)
+			return ret;
+	}
 
 	return 0;
 }
 
-static int mtdsi_unprepare(struct drm_panel *panel)
+// A fixed delay, traced so a bring-up timeline shows where the time went
+static void mtdsi_delay(struct mtdsi *ctx, const char *what, unsigned int ms)
 {
-	struct mtdsi *ctx = to_mtdsi(panel);
+	motivo_trace_delay(ctx->base.dev, what, ms, ms);
+	msleep(ms);
+}
 
-	gpiod_set_value_cansleep(ctx->reset, 1);
-	usleep_range(1000, 2000);
-	regulator_disable(ctx->power);
+// Wait out a deadline an earlier command set, if it has not passed yet
+static void mtdsi_wait_until(struct mtdsi *ctx, const char *what, ktime_t deadline)
+{
+	s64 us = ktime_us_delta(deadline, ktime_get());
 
-	return 0;
+	if (us <= 0)
+		return;
+
+	motivo_trace_delay(ctx->base.dev, what, DIV_ROUND_UP(us, 1000),
+			   DIV_ROUND_UP(us, 1000));
+	fsleep(us);
 }
 
-static int mtdsi_prepare(struct drm_panel *panel)
+/*
+ * Wait until the DCS power mode reads (mode & @mask) == @want, but at least
+ * @min_ms and at most @max_ms, the fixed delay this stands in for. The 0Ah
+ * bits only show that the command was taken, so @min_ms is the controller
+ * minimum and polling can only end a longer wait early. A controller that
+ * cannot be read costs exactly the old delay.
+ */
+static void mtdsi_wait_power_mode(struct mtdsi *ctx, const char *what, u8 mask,
+				  u8 want, unsigned int min_ms, unsigned int max_ms)
 {
-	struct mtdsi *ctx = to_mtdsi(panel);
-	int retry,ret;
+	ktime_t start = ktime_get();
+	ktime_t timeout = ktime_add_ms(start, max_ms);
+	s64 waited;
+	u8 mode;
+	int ret;
 
-    atomic_set(&errorFlag, 0); // Clear the error flag
+	if (!ctx->poll_ready) {
+		mtdsi_delay(ctx, what, max_ms);
+		return;
+	}
 
-	ret = regulator_enable(ctx->power);
+	if (min_ms)
+		msleep(min_ms);
 
-	usleep_range(1000, 2000);
+	for (;;) {
+		ret = mipi_dsi_dcs_get_power_mode(ctx->dsi, &mode);
+		if (!ret && (mode & mask) == want)
+			break;
 
-	// MIPI needs to keep the LP11 state before the lcm_reset pin is pulled high
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_nop(ctx->dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(panel->dev, "DSI: Failed to return to the LP11 state prior prepare: %d\n", ret);
-//		return 0; //Do not error here yet. This is DSI transfer warmup.
+		if (ktime_after(ktime_get(), timeout)) {
+			motivo_trace_delay(ctx->base.dev, what,
+					   ktime_ms_delta(ktime_get(), start), max_ms);
+			dev_dbg(ctx->base.dev, "DSI: %s not reported after %u ms\n",
+				what, max_ms);
+			return;
+		}
+
+		usleep_range(1000, 2000);
 	}
-	usleep_range(1000, 2000);
 
-	gpiod_set_value_cansleep(ctx->reset, 0);
-	msleep(50);
-	gpiod_set_value_cansleep(ctx->reset, 1);
-	usleep_range(6000, 10000);
+	waited = ktime_ms_delta(ktime_get(), start);
+	motivo_trace_delay(ctx->base.dev, what, waited, max_ms);
+	dev_dbg(ctx->base.dev, "DSI: %s ready after %lld of %u ms\n",
+		what, waited, max_ms);
+}
 
-	ret = mtdsi_init_dcs_cmd(ctx);
-	if (ret < 0) {
-		dev_err(panel->dev, "DSI: Failed to initialize panel: %d\n", ret);
-		goto poweroff;
+/*
+ * Serve an init table delay, cut short down to the controller minimum when
+ * it follows sleep-out or display-on. The sleep-out delay is the panel's
+ * sleep-out time rather than the table's.
+ */
+static void mtdsi_table_delay(struct mtdsi *ctx, u8 last_dcs, unsigned int ms)
+{
+	switch (last_dcs) {
+	case MIPI_DCS_EXIT_SLEEP_MODE:
+		ms = ctx->timing.sleep_out_ms;
+		mtdsi_wait_power_mode(ctx, "sleep-out",
+				      MIPI_DCS_POWER_MODE_SLEEP | MTDSI_POWER_MODE_BOOSTER,
+				      MIPI_DCS_POWER_MODE_SLEEP | MTDSI_POWER_MODE_BOOSTER,
+				      min_t(unsigned int, ms, CMD_DELAY), ms);
+		break;
+	case MIPI_DCS_SET_DISPLAY_ON:
+		mtdsi_wait_power_mode(ctx, "display-on", MIPI_DCS_POWER_MODE_DISPLAY,
+				      MIPI_DCS_POWER_MODE_DISPLAY, 0, ms);
+		break;
+	default:
+		mtdsi_delay(ctx, "table", ms);
 	}
+}
 
-	return 0;
+static void mtdsi_shadow_clear(struct mtdsi *ctx)
+{
+	bitmap_zero(ctx->shadow.valid, MTDSI_SHADOW_PAGES * 256);
+}
 
-poweroff:
-	regulator_disable(ctx->power);
-	usleep_range(1000, 2000);
-	gpiod_set_value_cansleep(ctx->reset, 0);
+static void mtdsi_shadow_set(struct mtdsi *ctx, u8 page, u8 reg, u8 val)
+{
+	if (page >= MTDSI_SHADOW_PAGES)
+		return;
 
-	return ret;
+	ctx->shadow.val[page][reg] = val;
+	__set_bit(page * 256 + reg, ctx->shadow.valid);
 }
 
-static int mtdsi_exit_sleep_mode(struct mtdsi *ctx)
+static bool mtdsi_shadow_holds(struct mtdsi *ctx, u8 page, u8 reg, u8 val)
 {
-	struct mipi_dsi_device *dsi = ctx->dsi;
-	int retry,ret;
+	return page < MTDSI_SHADOW_PAGES &&
+	       test_bit(page * 256 + reg, ctx->shadow.valid) &&
+	       ctx->shadow.val[page][reg] == val;
+}
 
-	dsi->mode_flags &= ~MIPI_DSI_MODE_LPM;
+// Note @n table ops from @op, written or known to hold their value already
+static void mtdsi_shadow_record(struct mtdsi *ctx, const u8 *op, unsigned int n,
+				u8 page)
+{
+	unsigned int k;
 
-	// MIPI needs to return to the LP11 state before enabling all blocks inside the display
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_nop(ctx->dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(&dsi->dev, "DSI: Failed to return to the LP11 state prior sleep mode exit: %d\n", ret);
-//		return 0; //Do not error here yet. This is DSI transfer warmup.
-	}
-	usleep_range(1000, 20000);
-
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_exit_sleep_mode(dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(&dsi->dev, "DSI: Failed to exit sleep mode: %d\n", ret);
-		return ret;
-	}
+	for (k = 0; k < n; k++, op = mtdsi_op_next(op))
+		if (mtdsi_is_reg_write(op))
+			mtdsi_shadow_set(ctx, page, op[2], op[3]);
+}
 
-	msleep(10);
+// Follow the power state through the standard DCS commands of an init table
+static void mtdsi_track_dcs(struct mtdsi *ctx, u8 cmd)
+{
+	switch (cmd) {
+	case MIPI_DCS_SOFT_RESET:
+		// Which pages survive a soft reset is not documented
+		mtdsi_shadow_clear(ctx);
+		fallthrough;
+	case MIPI_DCS_ENTER_SLEEP_MODE:
+		ctx->state = MTDSI_STATE_SLEEP;
+		ctx->sleep_out_ok = ktime_add_ms(ktime_get(), SLEEP_GUARD);
+		break;
+	case MIPI_DCS_EXIT_SLEEP_MODE:
+		ctx->state = MTDSI_STATE_AWAKE;
+		ctx->sleep_in_ok = ktime_add_ms(ktime_get(), SLEEP_GUARD);
+		break;
+	case MIPI_DCS_SET_DISPLAY_ON:
+		ctx->state = MTDSI_STATE_ON;
+		break;
+	case MIPI_DCS_SET_DISPLAY_OFF:
+		if (ctx->state == MTDSI_STATE_ON)
+			ctx->state = MTDSI_STATE_AWAKE;
+		break;
+	}
+}
 
-    retry = 0;
-    do {
-		ret = mipi_dsi_dcs_set_display_on(dsi);
-		if (ret) msleep(RETRY_DELAY);
-		++retry;
-    }
-    while (ret && retry < RETRY_CMD);
-	if (ret < 0) {
-		dev_err(&dsi->dev, "DSI: Failed to set display on: %d\n", ret);
-		return ret;
+/*
+ * Defaults-aware init: the first init after a reset reads every vendor
+ * register before writing it, and writes that would not change it are
+ * skipped on later inits straight after a reset. The reset values are
+ * learnt from the controller itself rather than taken from a datasheet.
+ */
+static bool mtdsi_prune_start(struct mtdsi *ctx, bool *learn)
+{
+	const u8 *op;
+	unsigned int n = 0;
+
+	*learn = false;
+	if (!ctx->prune || !ctx->fresh)
+		return false;
+
+	if (ctx->prune_learned)
+		return true;
+
+	for (op = ctx->init_cmds; op[0] != MTDSI_OP_END; op = mtdsi_op_next(op))
+		n++;
+
+	// A new table, as after identification or a script load, needs a new map
+	if (!ctx->prune_map || ctx->prune_ops != n) {
+		if (ctx->prune_map)
+			devm_kfree(&ctx->dsi->dev, ctx->prune_map);
+		ctx->prune_map = devm_kcalloc(&ctx->dsi->dev, BITS_TO_LONGS(n),
+					      sizeof(unsigned long), GFP_KERNEL);
+		if (!ctx->prune_map) {
+			ctx->prune = false;
+			return false;
+		}
+		ctx->prune_ops = n;
 	}
 
-	return 0;
+	*learn = true;
+	return false;
 }
 
-static int mtdsi_enable(struct drm_panel *panel)
+static int mtdsi_send_init_cmds(struct mtdsi *ctx)
 {
-	struct mtdsi *ctx = to_mtdsi(panel);
-	struct mipi_dsi_device *dsi = ctx->dsi;
-	int ret;
+	struct drm_panel *panel = &ctx->base;
+	const u8 *op = ctx->init_cmds;
+	unsigned int i, k, n;
+	bool prune, learn;
+	int err = 0;
+	u8 page = 0, last_dcs = MIPI_DCS_NOP, val;
 
-	mtdsi_switch_page(dsi, 0x00);
+	ctx->init_xfers = 0;
+	ctx->pruned = 0;
 
-	msleep(5);
+	if (!op)
+		return 0;
 
-	ret = mtdsi_exit_sleep_mode(ctx);
-	if (ret < 0) {
-		dev_err(panel->dev, "DSI: Failed to activate panel: %d\n", ret);
-        atomic_set(&errorFlag, 1);
-		return ret;
-	}
+	prune = mtdsi_prune_start(ctx, &learn);
 
-	atomic_set(&errorFlag, 0);
+	for (i = 0; op[0] != MTDSI_OP_END; i += n) {
+		const u8 *data = op + MTDSI_OP_HDR;
 
-	msleep(120);
+		if (READ_ONCE(ctx->recovery_yield))
+			return -ECANCELED;
 
-	return 0;
-}
+		// A pruned write goes alone, the burst after it is still sent
+		if (learn || (prune && test_bit(i, ctx->prune_map)))
+			n = 1;
+		else
+			n = mtdsi_burst_len(ctx, op, i, page, prune);
 
-static int mtdsi_get_modes(struct drm_panel *panel,
-			      struct drm_connector *connector)
-{
-	struct mtdsi *ctx = to_mtdsi(panel);
-	const struct drm_display_mode *m = ctx->desc->modes;
-	struct drm_display_mode *mode;
+		// Drop page 3 writes, and the switch itself, on revisions without it
+		if (ctx->no_page3 && op[0] == MTDSI_OP_DCS &&
+		    (mtdsi_is_switch_page(op) ? data[3] == 3 : page == 3)) {
+			n = 1;
+			goto next;
+		}
 
-	mode = drm_mode_duplicate(connector->dev, m);
-	if (!mode) {
-		dev_err(panel->dev, "DSI: Failed to add mode %ux%u@%u\n",
-			m->hdisplay, m->vdisplay, drm_mode_vrefresh(m));
-		return -ENOMEM;
-	}
+		if (mtdsi_is_switch_page(op) && data[3] == ctx->page) {
+			ctx->page_skips++;
+			goto next;
+		}
 
-	mode->type = DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED;
-	drm_mode_set_name(mode);
-	drm_mode_probed_add(connector, mode);
+		if (page != 0 && mtdsi_is_reg_write(op)) {
+			if (prune && test_bit(i, ctx->prune_map)) {
+				mtdsi_shadow_record(ctx, op, 1, page);
+				ctx->pruned++;
+				goto next;
+			}
 
-	connector->display_info.width_mm = ctx->desc->size.width_mm;
-	connector->display_info.height_mm = ctx->desc->size.height_mm;
-	connector->display_info.bpc = ctx->desc->bpc;
+			if (learn && !mtdsi_read_reg(ctx, data[0], &val) && val == data[1])
+				__set_bit(i, ctx->prune_map);
+		}
 
-	/*
-	 * TODO: Remove once all drm drivers call
-	 * drm_connector_set_orientation_from_panel()
-	 */
+		if (page == 0 && op[0] == MTDSI_OP_DCS &&
+		    data[0] == MIPI_DCS_EXIT_SLEEP_MODE)
+			mtdsi_wait_until(ctx, "sleep-in", ctx->sleep_out_ok);
 
-	drm_connector_set_panel_orientation(connector, DRM_MODE_PANEL_ORIENTATION_LEFT_UP);
+		switch (op[0]) {
+		case MTDSI_OP_DELAY:
+			mtdsi_table_delay(ctx, last_dcs, data[0]);
+			err = 0;
+			break;
 
-	return 1;
-}
+		case MTDSI_OP_DCS:
+			if (n > 1) {
+				err = mtdsi_write_burst(ctx, op, n);
+				break;
+			}
 
-static enum drm_panel_orientation mtdsi_get_orientation(struct drm_panel *panel)
-{
-	struct mtdsi *ctx = to_mtdsi(panel);
+			err = mtdsi_dcs_write_retry(ctx, data, op[1]);
+			ctx->init_xfers++;
+			if (mtdsi_is_switch_page(op))
+				ctx->page = err < 0 ? -1 : data[3];
+			break;
 
-	return ctx->orientation;
-}
+		default:
+			err = -EINVAL;
+		}
 
-static const struct drm_panel_funcs mtdsi_funcs = {
-	.disable = mtdsi_disable,
-	.unprepare = mtdsi_unprepare,
-	.prepare = mtdsi_prepare,
-	.enable = mtdsi_enable,
-	.get_modes = mtdsi_get_modes,
-	.get_orientation = mtdsi_get_orientation,
-};
+		if (err < 0) {
+			dev_err(panel->dev,
+				"DSI: Failed to write init commands %u\n", i);
+			return err;
+		}
 
-static int mtdsi_add(struct mtdsi *ctx)
-{
-	struct device *dev = &ctx->dsi->dev;
-	int err;
+		if (op[0] == MTDSI_OP_DCS)
+			mtdsi_shadow_record(ctx, op, n, page);
 
-	ctx->power = devm_regulator_get(dev, "power");
-	if (IS_ERR(ctx->power))
-		return PTR_ERR(ctx->power);
+next:
+		last_dcs = MIPI_DCS_NOP;
+		if (mtdsi_is_switch_page(op)) {
+			page = data[3];
+		} else if (page == 0 && op[0] == MTDSI_OP_DCS) {
+			last_dcs = data[0];
+			mtdsi_track_dcs(ctx, last_dcs);
+		}
 
-	ctx->reset = devm_gpiod_get_optional(dev, "reset", GPIOD_OUT_LOW);
-	if (IS_ERR(ctx->reset)) {
-		dev_err(dev, "DSI: Cannot get reset-gpios %ld\n",
-			PTR_ERR(ctx->reset));
-		return PTR_ERR(ctx->reset);
+		for (k = 0; k < n; k++)
+			op = mtdsi_op_next(op);
 	}
 
-	gpiod_set_value_cansleep(ctx->reset, 0);
-
-	drm_panel_init(&ctx->base, dev, &mtdsi_funcs,
-		       DRM_MODE_CONNECTOR_DSI);
-	err = of_drm_get_panel_orientation(dev->of_node, &ctx->orientation);
-	if (err < 0) {
-		dev_err(dev, "DSI: %pOF: Failed to get orientation %d\n", dev->of_node, err);
-		return err;
+	if (learn) {
+		ctx->prune_learned = true;
+		dev_info(panel->dev, "DSI: %u init writes restore reset values, skipped from now on\n",
+			 bitmap_weight(ctx->prune_map, ctx->prune_ops));
 	}
 
-	err = drm_panel_of_backlight(&ctx->base);
-	if (err)
-		return err;
-
-	ctx->base.funcs = &mtdsi_funcs;
-	ctx->base.dev = &ctx->dsi->dev;
+	return 0;
+}
 
-	ctx->base.prepare_prev_first = true;
+static int mtdsi_switch_page(struct mtdsi *ctx, u8 page);
 
-	drm_panel_add(&ctx->base);
+// The last write of the table to a register is the value it should end with
+static bool mtdsi_last_write(const u8 *op, u8 page)
+{
+	const u8 *next;
+	u8 cur = page;
+
+	for (next = mtdsi_op_next(op); next[0] != MTDSI_OP_END; next = mtdsi_op_next(next)) {
+		if (mtdsi_is_switch_page(next))
+			cur = next[5];
+		else if (cur == page && mtdsi_is_reg_write(next) && next[2] == op[2])
+			return false;
+	}
 
-	return 0;
+	return true;
 }
 
-static int mtdsi_probe(struct mipi_dsi_device *dsi)
+// Read back the last write to each vendor register, see motivo_prune_check()
+static void mtdsi_prune_verify(struct mtdsi *ctx)
 {
-	struct mtdsi *ctx;
+	struct device *dev = ctx->base.dev;
+	unsigned int bad = 0;
+	const u8 *op;
+	u8 page = 0, val = 0;
 	int ret;
-	const struct panel_desc *desc;
 
-	ctx = devm_kzalloc(&dsi->dev, sizeof(*ctx), GFP_KERNEL);
-	if (!ctx)
-		return -ENOMEM;
+	for (op = ctx->init_cmds; op[0] != MTDSI_OP_END; op = mtdsi_op_next(op)) {
+		if (mtdsi_is_switch_page(op)) {
+			page = op[5];
+			continue;
+		}
+
+		if (page == 0 || (page == 3 && ctx->no_page3) ||
+		    !mtdsi_is_reg_write(op) || !mtdsi_last_write(op, page))
+			continue;
+
+		ret = mtdsi_switch_page(ctx, page);
+		if (ret >= 0)
+			ret = mtdsi_read_reg(ctx, op[2], &val);
+		if (ret >= 0)
+			mtdsi_shadow_set(ctx, page, op[2], val);
+		bad += motivo_prune_check(dev, page, op[2], ret, val, op[3]);
+	}
+
+	mtdsi_switch_page(ctx, 0x00);
+	ctx->prune = motivo_prune_done(dev, bad, ctx->pruned);
+}
+
+/*
+ * The init tables are a few hundred short DCS writes, which is slow over the
+ * LP escape link. Send them in HS mode where the panel allows it, and replay
+ * the whole sequence in LP mode if any HS transfer fails.
+ */
+static int mtdsi_init_dcs_cmd(struct mtdsi *ctx)
+{
+	struct device *dev = ctx->base.dev;
+	unsigned int skips = ctx->page_skips;
+	bool hs = ctx->init_hs;
+	ktime_t start;
+	int err;
+
+	mtdsi_set_lpm(ctx, !hs);
+	start = ktime_get();
+	err = mtdsi_send_init_cmds(ctx);
+
+	if (err && err != -ECANCELED && hs) {
+		dev_warn(dev, "DSI: HS init failed (%d), falling back to LP mode\n", err);
+		ctx->init_hs = false;
+		ctx->fresh = false;
+		hs = false;
+
+		mtdsi_set_lpm(ctx, true);
+		start = ktime_get();
+		err = mtdsi_send_init_cmds(ctx);
+	}
+
+	ctx->fresh = false;
+	if (!err && ctx->pruned && ctx->prune_verify)
+		mtdsi_prune_verify(ctx);
+
+	mtdsi_set_lpm(ctx, ctx->desc->mode_flags & MIPI_DSI_MODE_LPM);
+	if (err)
+		return err;
+
+	ctx->init_us[hs] = ktime_us_delta(ktime_get(), start);
+	dev_dbg(dev, "DSI: init sequence sent in %lld us (%s, %u transfers, %u page switches saved, %u writes pruned)\n",
+		ctx->init_us[hs], hs ? "HS" : "LP", ctx->init_xfers, ctx->page_skips - skips,
+		ctx->pruned);
+
+	return 0;
+}
+
+static int mtdsi_switch_page(struct mtdsi *ctx, u8 page)
+{
+	const u8 cmd[] = { MTDSI_DCS_SWITCH_PAGE, 0x98, 0x81, page };
+	int ret;
+
+	if (ctx->page == page) {
+		ctx->page_skips++;
+		return 0;
+	}
+
+	ret = mtdsi_dcs_write_retry(ctx, cmd, sizeof(cmd));
+	if (ret) {
+		ctx->page = -1;
+		dev_err(&ctx->dsi->dev,
+			"DSI: Error switching panel controller page (%d)\n", ret);
+		return ret;
+	}
+
+	ctx->page = page;
+
+	return 0;
+}
+
+/*
+ * MIPI needs to return to the LP11 state before enabling all blocks inside
+ * the display. The first transfer after a host state change may fail, so a
+ * failure here is not an error and is not retried.
+ */
+static void mtdsi_lp11_warmup(struct mtdsi *ctx)
+{
+	int ret;
+
+	ret = mipi_dsi_dcs_nop(ctx->dsi);
+	if (ret < 0)
+		dev_dbg(ctx->base.dev, "DSI: LP11 warmup transfer failed: %d\n", ret);
+}
+
+/*
+ * Writes to a missing panel do not fail reliably, but a read needs a live
+ * controller to answer. Ask for the power mode once the panel is out of
+ * reset, allowing one more try for the warmup glitch above.
+ */
+static int mtdsi_detect(struct mtdsi *ctx)
+{
+	u8 mode;
+	int ret;
+
+	ret = mipi_dsi_dcs_get_power_mode(ctx->dsi, &mode);
+	if (ret < 0) {
+		mtdsi_delay(ctx, "detect", CMD_DELAY);
+		ret = mipi_dsi_dcs_get_power_mode(ctx->dsi, &mode);
+	}
+
+	if (ret < 0) {
+		dev_err(ctx->base.dev, "DSI: No panel detected: %d\n", ret);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+
+static int mtdsi_enter_sleep_mode(struct mtdsi *ctx)
+{
+	struct mipi_dsi_device *dsi = ctx->dsi;
+	int ret;
+
+	dsi->mode_flags &= ~MIPI_DSI_MODE_LPM;
+
+	mtdsi_retry_budget_start(ctx);
+	mtdsi_lp11_warmup(ctx);
+	usleep_range(1000, 2000);
+
+	ret = mtdsi_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_OFF);
+	if (ret < 0) {
+		dev_err(&dsi->dev, "DSI: Failed to set display off: %d\n", ret);
+		return ret;
+	}
+
+	mtdsi_delay(ctx, "display off", CMD_DELAY);
+	mtdsi_wait_until(ctx, "sleep-out", ctx->sleep_in_ok);
+
+	ret = mtdsi_dcs_cmd(ctx, MIPI_DCS_ENTER_SLEEP_MODE);
+	if (ret < 0) {
+		dev_err(&dsi->dev, "DSI: Failed to enter sleep mode: %d\n", ret);
+		return ret;
+	}
+
+	mtdsi_track_dcs(ctx, MIPI_DCS_ENTER_SLEEP_MODE);
+
+	return 0;
+}
+
+/*
+ * Hand a failed panel to the recovery worker. Called with the lock held and
+ * never blocks, so the DRM commit that hit the failure is not held up.
+ */
+static void mtdsi_fail(struct mtdsi *ctx, int err)
+{
+	if (ctx->health == MTDSI_HEALTH_OK) {
+		ctx->failed_at = ktime_get();
+		ctx->recovery_delay = RECOVERY_DELAY;
+	}
+
+	ctx->health = MTDSI_HEALTH_FAILED;
+	dev_warn(ctx->base.dev, "DSI: Panel failure (%d), recovering in %u ms\n",
+		 err, ctx->recovery_delay);
+	queue_delayed_work(system_long_wq, &ctx->recovery_work,
+			   msecs_to_jiffies(ctx->recovery_delay));
+}
+
+/*
+ * The recovery worker holds the lock across a whole reset and init. A DRM
+ * callback does not wait that out: it has the worker give up at its next
+ * init write, which then requeues itself, and carries on with the panel
+ * still failed.
+ */
+static void mtdsi_lock_yield(struct mtdsi *ctx)
+{
+	WRITE_ONCE(ctx->recovery_yield, true);
+	mutex_lock(&ctx->lock);
+	WRITE_ONCE(ctx->recovery_yield, false);
+}
+
+// As above, for the callbacks that drop the recovery altogether
+static void mtdsi_recovery_cancel(struct mtdsi *ctx)
+{
+	WRITE_ONCE(ctx->recovery_yield, true);
+	cancel_delayed_work_sync(&ctx->recovery_work);
+	WRITE_ONCE(ctx->recovery_yield, false);
+}
+
+static void mtdsi_esd_schedule(struct mtdsi *ctx)
+{
+	if (ctx->esd_period)
+		queue_delayed_work(system_long_wq, &ctx->esd_work,
+				   msecs_to_jiffies(ctx->esd_period));
+}
+
+static int mtdsi_disable(struct drm_panel *panel)
+{
+	struct mtdsi *ctx = to_mtdsi(panel);
+	int ret = 0;
+
+	trace_motivo_panel_begin(panel->dev, "disable");
+	cancel_delayed_work_sync(&ctx->esd_work);
+
+	mtdsi_lock_yield(ctx);
+	ctx->enabled = false;
+
+	// A panel waiting for recovery is about to be powered down anyway
+	if (ctx->health != MTDSI_HEALTH_OK)
+		goto out;
+
+	// Already taken down by mtdsi_shutdown()
+	if (ctx->state == MTDSI_STATE_OFF)
+		goto out;
+
+	ret = mtdsi_enter_sleep_mode(ctx);
+	if (ret < 0) {
+		dev_err(panel->dev, "DSI: Failed to set panel off: %d\n", ret);
+		goto out;
+	}
+
+	// The rail may be cut once this is over
+	mtdsi_wait_power_mode(ctx, "sleep-in",
+			      MIPI_DCS_POWER_MODE_SLEEP | MTDSI_POWER_MODE_BOOSTER, 0,
+			      SLEEP_GUARD, ctx->timing.sleep_in_ms);
+
+out:
+	mutex_unlock(&ctx->lock);
+	trace_motivo_panel_end(panel->dev, "disable", ret);
+
+	return ret;
+}
+
+static void mtdsi_power_off(struct mtdsi *ctx)
+{
+	if (ctx->powered) {
+		gpiod_set_value_cansleep(ctx->reset, 1);
+		usleep_range(1000, 2000);
+		regulator_disable(ctx->power);
+		ctx->powered = false;
+	}
+	ctx->standby = false;
+	ctx->state = MTDSI_STATE_OFF;
+	ctx->page = -1;
+	mtdsi_shadow_clear(ctx);
+}
+
+/*
+ * Warm standby: a panel that went cleanly to sleep keeps its supply and
+ * registers until runtime PM autosuspends it, so a prepare/enable within
+ * the autosuspend delay is a sleep-out and display-on rather than a full
+ * reset and init. Only panels with motivo,standby-ms get it, the delay
+ * comes from there and can be changed in power/autosuspend_delay_ms. A
+ * few hundred ms lets a refresh rate switch stay warm. The backlight is
+ * already off through drm_panel_disable(). vc4 does not use the DRM self
+ * refresh helpers, so an idle screen keeps scanning out and never gets
+ * here, only a real disable such as a modeset or DPMS off does.
+ */
+static int mtdsi_runtime_suspend(struct device *dev)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	if (ctx->standby)
+		mtdsi_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
+// The supply comes up in prepare, together with the init
+static int mtdsi_runtime_resume(struct device *dev)
+{
+	return 0;
+}
+
+static int mtdsi_unprepare(struct drm_panel *panel)
+{
+	struct mtdsi *ctx = to_mtdsi(panel);
+
+	trace_motivo_panel_begin(panel->dev, "unprepare");
+	mtdsi_recovery_cancel(ctx);
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->standby_ok && !ctx->suspended && ctx->powered &&
+	    ctx->health == MTDSI_HEALTH_OK && ctx->state == MTDSI_STATE_SLEEP) {
+		ctx->standby = true;
+	} else {
+		ctx->health = MTDSI_HEALTH_OK;
+		mtdsi_power_off(ctx);
+	}
+
+	mutex_unlock(&ctx->lock);
+
+	if (ctx->active) {
+		ctx->active = false;
+		pm_runtime_mark_last_busy(panel->dev);
+		pm_runtime_put_autosuspend(panel->dev);
+	}
+
+	trace_motivo_panel_end(panel->dev, "unprepare", 0);
+
+	return 0;
+}
+
+/*
+ * "motivo,auto" candidates. The module ID is what the panel vendor burnt
+ * into the ID1-3 OTP registers; it is not documented, so the overlay lists
+ * the IDs of the modules in the field in motivo,<name>-id. The overlay also
+ * names a variant as a second compatible, which a panel whose ID is not
+ * listed keeps.
+ */
+struct mtdsi_variant {
+	const char *name;
+	const struct panel_desc *desc;
+};
+
+static const struct mtdsi_variant mtdsi_variants[] = {
+	{ "mt1280800a", &mt1280800a_desc },
+	{ "mt1280800b", &mt1280800b_desc },
+};
+
+static const char *mtdsi_variant_name(const struct panel_desc *desc)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(mtdsi_variants); i++)
+		if (mtdsi_variants[i].desc == desc)
+			return mtdsi_variants[i].name;
+
+	return NULL;
+}
+
+static const u8 mtdsi_ili9881c_id[] = { 0x98, 0x81, 0x0c };
+
+static void mtdsi_hotplug_work(struct work_struct *work)
+{
+	struct mtdsi *ctx = container_of(work, struct mtdsi, hotplug_work);
+	struct drm_connector *connector;
+
+	mutex_lock(&ctx->lock);
+	connector = ctx->connector;
+	if (connector)
+		drm_connector_get(connector);
+	mutex_unlock(&ctx->lock);
+
+	if (connector) {
+		drm_kms_helper_hotplug_event(connector->dev);
+		drm_connector_put(connector);
+	}
+}
+
+// The module ID the overlay lists for variant @i, in motivo,<name>-id
+static int mtdsi_variant_id(struct device *dev, unsigned int i, u8 *id)
+{
+	char prop[32];
+
+	KUNIT_STATIC_STUB_REDIRECT(mtdsi_variant_id, dev, i, id);
+
+	snprintf(prop, sizeof(prop), "motivo,%s-id", mtdsi_variants[i].name);
+
+	return of_property_read_u8_array(dev->of_node, prop, id, 3);
+}
+
+static void mtdsi_load_init_script(struct mtdsi *ctx);
+
+/*
+ * Identify a "motivo,auto" panel on the first prepare: the controller ID on
+ * page 1, whether it has command page 3, and the module ID. A panel that
+ * cannot be told apart keeps the overlay's fallback variant, and so does
+ * one identified as a variant the attached link cannot drive. Without a
+ * fallback it is not driven at all rather than with the wrong sequence.
+ */
+static int mtdsi_identify(struct mtdsi *ctx)
+{
+	struct device *dev = &ctx->dsi->dev;
+	const struct panel_desc *desc = NULL;
+	u8 ctrl[3], id[3], val, want[3];
+	unsigned int i;
+	int ret = 0;
+
+	ret = mtdsi_switch_page(ctx, 0x01);
+	for (i = 0; !ret && i < ARRAY_SIZE(ctrl); i++)
+		ret = mtdsi_read_reg(ctx, i, &ctrl[i]);
+	if (ret < 0 || memcmp(ctrl, mtdsi_ili9881c_id, sizeof(ctrl))) {
+		dev_warn(dev, "DSI: auto: no ILI9881C controller ID\n");
+		goto out;
+	}
+
+	// Reads on a page the controller does not have are not acknowledged
+	ctx->no_page3 = mtdsi_switch_page(ctx, 0x03) < 0 ||
+			mtdsi_read_reg(ctx, 0x01, &val) < 0;
+
+	ret = mtdsi_switch_page(ctx, 0x00);
+	for (i = 0; !ret && i < ARRAY_SIZE(id); i++)
+		ret = mtdsi_read_reg(ctx, MTDSI_DCS_READ_ID1 + i, &id[i]);
+	if (ret < 0) {
+		dev_warn(dev, "DSI: auto: cannot read module ID\n");
+		goto out;
+	}
+
+	dev_info(dev, "DSI: auto: module ID %3ph%s\n", id,
+		 ctx->no_page3 ? ", no command page 3" : "");
+
+	// Only panel A was made without page 3
+	if (ctx->no_page3) {
+		desc = &mt1280800a_desc;
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(mtdsi_variants); i++) {
+		if (mtdsi_variant_id(dev, i, want))
+			continue;
+
+		if (!memcmp(id, want, sizeof(id))) {
+			desc = mtdsi_variants[i].desc;
+			goto out;
+		}
+	}
+
+	dev_warn(dev, "DSI: auto: module ID %3ph is in no motivo,<variant>-id\n", id);
+
+out:
+	if (!desc)
+		desc = ctx->fallback;
+	if (!desc) {
+		dev_err(dev, "DSI: auto: panel not identified and no fallback variant\n");
+		return -ENODEV;
+	}
+
+	dev_info(dev, "DSI: auto: detected %s\n", mtdsi_variant_name(desc));
+
+	/*
+	 * vc4 cannot be re-attached from within a commit, so a variant that
+	 * needs another link than the one attached at probe cannot be driven.
+	 * The overlay's own variant runs on the link it was attached with, and
+	 * is kept; the A and B panels differ in burst mode, so this is always
+	 * the case between them.
+	 */
+	if (desc->lanes != ctx->desc->lanes || desc->format != ctx->desc->format ||
+	    (desc->mode_flags ^ ctx->desc->mode_flags) & ~MIPI_DSI_MODE_LPM) {
+		if (!ctx->fallback) {
+			dev_err(dev, "DSI: auto: %s needs other link settings, fix the overlay\n",
+				mtdsi_variant_name(desc));
+			return -ENODEV;
+		}
+
+		dev_warn(dev, "DSI: auto: %s needs other link settings, keeping %s\n",
+			 mtdsi_variant_name(desc), mtdsi_variant_name(ctx->fallback));
+		desc = ctx->fallback;
+	}
+
+	ctx->detect_pending = false;
+	if (desc == ctx->desc)
+		return 0;
+
+	// The script loaded at probe was the fallback's, load the detected one's
+	if (ctx->init_cmds != ctx->desc->init_cmds)
+		devm_kfree(&ctx->dsi->dev, ctx->init_cmds);
+	ctx->desc = desc;
+	ctx->prune_learned = false;
+	mtdsi_load_init_script(ctx);
+
+	// The connector was probed with the fallback timings
+	schedule_work(&ctx->hotplug_work);
+
+	return 0;
+}
+
+/*
+ * Bring @n registers from @reg on @page to @val, sending only the ones the
+ * shadow does not show at that value already. Runs of changed registers go
+ * out as one long write where the controller takes them, and the page is
+ * only switched if anything changed. The page is left where it is.
+ */
+static int mtdsi_update_regs(struct mtdsi *ctx, u8 page, u8 reg, const u8 *val,
+			     unsigned int n)
+{
+	unsigned int i, k, len, max;
+	u8 buf[BURST_MAX + 1];
+	int ret;
+
+	for (i = 0; i < n; i += len) {
+		len = 1;
+		if (mtdsi_shadow_holds(ctx, page, reg + i, val[i]))
+			continue;
+
+		ret = mtdsi_switch_page(ctx, page);
+		if (ret < 0)
+			return ret;
+
+		max = page && ctx->burst == MTDSI_BURST_OK ?
+		      min_t(unsigned int, n - i, BURST_MAX) : 1;
+		while (len < max && !mtdsi_shadow_holds(ctx, page, reg + i + len, val[i + len]))
+			len++;
+
+		buf[0] = reg + i;
+		memcpy(&buf[1], &val[i], len);
+
+		ret = mtdsi_dcs_write_retry(ctx, buf, len + 1);
+		if (ret < 0) {
+			if (page < MTDSI_SHADOW_PAGES)
+				bitmap_clear(ctx->shadow.valid, page * 256 + reg + i, len);
+			return ret;
+		}
+
+		for (k = 0; k < len; k++)
+			mtdsi_shadow_set(ctx, page, reg + i + k, val[i + k]);
+	}
+
+	return 0;
+}
+
+/*
+ * The init tables leave the pixel format at its RGB888 reset value (table A
+ * even soft-resets the controller), so an RGB666 link is set up after them
+ * with the standard DCS set_pixel_format on page 0.
+ */
+static int mtdsi_set_pixel_format(struct mtdsi *ctx)
+{
+	const u8 fmt = MIPI_DCS_PIXEL_FMT_18BIT << 4 | MIPI_DCS_PIXEL_FMT_18BIT;
+	int ret;
+
+	if (ctx->dsi->format == MIPI_DSI_FMT_RGB888)
+		return 0;
+
+	ret = mtdsi_update_regs(ctx, 0, MIPI_DCS_SET_PIXEL_FORMAT, &fmt, 1);
+	if (ret < 0)
+		dev_err(ctx->base.dev, "DSI: Failed to set the pixel format: %d\n", ret);
+
+	return ret;
+}
+
+/*
+ * The gamma curve of the init program, i.e. what the panel shows unless a
+ * curve was set through sysfs. Returns false if the program leaves any of
+ * the gamma registers alone.
+ */
+static bool mtdsi_gamma_defaults(struct mtdsi *ctx, u8 *gamma)
+{
+	DECLARE_BITMAP(seen, 2 * MOTIVO_GAMMA_TAPS);
+	const u8 *op;
+	int page = 0, tap;
+
+	bitmap_zero(seen, 2 * MOTIVO_GAMMA_TAPS);
+	for (op = ctx->init_cmds; op[0] != MTDSI_OP_END; op = mtdsi_op_next(op)) {
+		if (mtdsi_is_switch_page(op)) {
+			page = op[5];
+			continue;
+		}
+		if (page != MOTIVO_GAMMA_PAGE || !mtdsi_is_reg_write(op))
+			continue;
+
+		tap = motivo_gamma_tap(op[2]);
+		if (tap < 0)
+			continue;
+
+		gamma[tap] = op[3];
+		__set_bit(tap, seen);
+	}
+
+	return bitmap_full(seen, 2 * MOTIVO_GAMMA_TAPS);
+}
+
+/*
+ * The curve set through sysfs or else the init program's, with the CRTC
+ * gamma LUT of the last enable fitted onto it. Only the gamma registers
+ * that changed go out, so a new curve is a few transfers on a running
+ * panel rather than a re-init.
+ */
+static int mtdsi_write_gamma(struct mtdsi *ctx)
+{
+	u8 base[2 * MOTIVO_GAMMA_TAPS], gamma[2 * MOTIVO_GAMMA_TAPS];
+	int ret;
+
+	if (ctx->gamma_set)
+		memcpy(base, ctx->gamma, sizeof(base));
+	else if (!mtdsi_gamma_defaults(ctx, base))
+		return 0;
+
+	if (ctx->gamma_lut_set)
+		motivo_gamma_fit(ctx->gamma_lut, base, gamma);
+	else
+		memcpy(gamma, base, sizeof(gamma));
+
+	ret = mtdsi_update_regs(ctx, MOTIVO_GAMMA_PAGE, MOTIVO_GAMMA_POS, gamma,
+				MOTIVO_GAMMA_TAPS);
+	if (!ret)
+		ret = mtdsi_update_regs(ctx, MOTIVO_GAMMA_PAGE, MOTIVO_GAMMA_NEG,
+					gamma + MOTIVO_GAMMA_TAPS, MOTIVO_GAMMA_TAPS);
+	if (ret < 0)
+		dev_err(ctx->base.dev, "DSI: Failed to write the gamma curve: %d\n", ret);
+
+	return mtdsi_switch_page(ctx, 0) ?: ret;
+}
+
+/*
+ * Settings made at runtime, put back after the init program. Against the
+ * shadow of what the program wrote, only those that differ from it cost a
+ * transfer. The init program has usually used up the retry budget of the
+ * prepare, so they get one of their own.
+ */
+static int mtdsi_apply_settings(struct mtdsi *ctx)
+{
+	u8 cabc = ctx->cabc;
+	int ret;
+
+	mtdsi_retry_budget_start(ctx);
+
+	if (ctx->gamma_set || ctx->gamma_lut_set) {
+		ret = mtdsi_write_gamma(ctx);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (ctx->cabc >= 0) {
+		ret = mtdsi_update_regs(ctx, 0, MIPI_DCS_WRITE_POWER_SAVE, &cabc, 1);
+		if (ret < 0)
+			return ret;
+	}
+
+	return mtdsi_set_pixel_format(ctx);
+}
+
+// Reset the powered controller and send its init table
+static int mtdsi_reset_and_init(struct mtdsi *ctx)
+{
+	struct drm_panel *panel = &ctx->base;
+	int ret;
+
+	mtdsi_retry_budget_start(ctx);
+
+	// MIPI needs to keep the LP11 state before the lcm_reset pin is pulled high
+	mtdsi_lp11_warmup(ctx);
+	usleep_range(1000, 2000);
+
+	// The controller cannot be polled while held in reset
+	gpiod_set_value_cansleep(ctx->reset, 0);
+	mtdsi_delay(ctx, "reset low", ctx->timing.reset_low_ms);
+	gpiod_set_value_cansleep(ctx->reset, 1);
+	ctx->sleep_out_ok = ktime_add_ms(ktime_get(), SLEEP_GUARD);
+	mtdsi_wait_power_mode(ctx, "reset", 0, 0, CMD_DELAY,
+			      DIV_ROUND_UP(ctx->timing.reset_recovery_us, 1000));
+	ctx->state = MTDSI_STATE_SLEEP;
+	ctx->page = 0;
+	ctx->fresh = true;
+	mtdsi_shadow_clear(ctx);
+
+	ret = mtdsi_detect(ctx);
+	if (ret < 0)
+		return ret;
+
+	if (ctx->detect_pending) {
+		ret = mtdsi_identify(ctx);
+		if (ret < 0)
+			return ret;
+	}
+
+	ret = mtdsi_init_dcs_cmd(ctx);
+	if (ret < 0) {
+		dev_err(panel->dev, "DSI: Failed to initialize panel: %d\n", ret);
+		return ret;
+	}
+
+	return mtdsi_apply_settings(ctx);
+}
+
+/*
+ * A panel the firmware left lit in normal display mode is taken over as it
+ * is on the first prepare, without a reset or init. Anything else gets the
+ * full sequence.
+ */
+static bool mtdsi_take_over(struct mtdsi *ctx)
+{
+	u8 mode = 0;
+	int ret;
+
+	ctx->handoff = false;
+
+	ret = mipi_dsi_dcs_get_power_mode(ctx->dsi, &mode);
+	if (ret < 0 || (mode & MTDSI_POWER_MODE_LIT) != MTDSI_POWER_MODE_LIT) {
+		dev_info(ctx->base.dev, "DSI: Panel not lit (%d, 0x%02x), full init\n",
+			 ret, mode);
+		return false;
+	}
+
+	// When the firmware sent sleep-out is not known, allow for it being just now
+	ctx->state = MTDSI_STATE_ON;
+	ctx->sleep_in_ok = ktime_add_ms(ktime_get(), SLEEP_GUARD);
+	ctx->page = -1;
+	mtdsi_shadow_clear(ctx);
+	if (mtdsi_apply_settings(ctx) < 0)
+		return false;
+
+	dev_info(ctx->base.dev, "DSI: Taking over the panel lit by the firmware\n");
+
+	return true;
+}
+
+/*
+ * Reset and init stay in the atomic commit: with prepare_prev_first the host
+ * holds LP-11 for the reset release and starts HS video only after prepare
+ * returns, so the init table must be in by then.
+ */
+static int mtdsi_prepare(struct drm_panel *panel)
+{
+	struct mtdsi *ctx = to_mtdsi(panel);
+	int ret;
+
+	trace_motivo_panel_begin(panel->dev, "prepare");
+
+	// Holds off the autosuspend of a panel in standby
+	if (!ctx->active) {
+		ret = pm_runtime_resume_and_get(panel->dev);
+		if (ret < 0) {
+			trace_motivo_panel_end(panel->dev, "prepare", ret);
+			return ret;
+		}
+		ctx->active = true;
+	}
+
+	mutex_lock(&ctx->lock);
+
+	// Still initialised from standby, enable only has to wake it up
+	if (ctx->standby) {
+		ctx->standby = false;
+		ret = 0;
+		goto out;
+	}
+
+	ret = regulator_enable(ctx->power);
+	if (ret < 0) {
+		dev_err(panel->dev, "DSI: Failed to enable power: %d\n", ret);
+		goto out;
+	}
+
+	ctx->powered = true;
+
+	if (ctx->handoff && mtdsi_take_over(ctx))
+		goto out;
+
+	usleep_range(1000, 2000);
+
+	ret = mtdsi_reset_and_init(ctx);
+	if (ret == -ENODEV)
+		goto poweroff;
+
+	/*
+	 * A panel that answered but failed its init stays powered and goes to
+	 * the recovery worker, enable leaves the display-on to it.
+	 */
+	if (ret < 0) {
+		mtdsi_fail(ctx, ret);
+		ret = 0;
+	}
+
+	goto out;
+
+poweroff:
+	regulator_disable(ctx->power);
+	ctx->powered = false;
+	usleep_range(1000, 2000);
+	gpiod_set_value_cansleep(ctx->reset, 0);
+	ctx->state = MTDSI_STATE_OFF;
+	ctx->page = -1;
+	mtdsi_shadow_clear(ctx);
+
+out:
+	mutex_unlock(&ctx->lock);
+	trace_motivo_panel_end(panel->dev, "prepare", ret);
+
+	return ret;
+}
+
+/*
+ * Bring the panel up to display-on, sending only what it has not received
+ * yet. The init tables already end with sleep-out and display-on, so after
+ * a normal prepare there is nothing left to do here.
+ */
+static int mtdsi_power_on(struct mtdsi *ctx)
+{
+	struct mipi_dsi_device *dsi = ctx->dsi;
+	int ret;
+
+	if (ctx->state == MTDSI_STATE_ON)
+		return 0;
+
+	if (ctx->state == MTDSI_STATE_OFF)
+		return -ENODEV;
+
+	dsi->mode_flags &= ~MIPI_DSI_MODE_LPM;
+
+	mtdsi_retry_budget_start(ctx);
+
+	ret = mtdsi_switch_page(ctx, 0x00);
+	if (ret < 0)
+		return ret;
+
+	mtdsi_lp11_warmup(ctx);
+	usleep_range(1000, 2000);
+
+	if (ctx->state < MTDSI_STATE_AWAKE) {
+		// A warm wake can follow the sleep-in of the last disable closely
+		mtdsi_wait_until(ctx, "sleep-in", ctx->sleep_out_ok);
+
+		ret = mtdsi_dcs_cmd(ctx, MIPI_DCS_EXIT_SLEEP_MODE);
+		if (ret < 0) {
+			dev_err(&dsi->dev, "DSI: Failed to exit sleep mode: %d\n", ret);
+			return ret;
+		}
+
+		mtdsi_wait_power_mode(ctx, "sleep-out",
+				      MIPI_DCS_POWER_MODE_SLEEP | MTDSI_POWER_MODE_BOOSTER,
+				      MIPI_DCS_POWER_MODE_SLEEP | MTDSI_POWER_MODE_BOOSTER,
+				      CMD_DELAY, ctx->timing.sleep_out_ms);
+		mtdsi_track_dcs(ctx, MIPI_DCS_EXIT_SLEEP_MODE);
+	}
+
+	ret = mtdsi_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_ON);
+	if (ret < 0) {
+		dev_err(&dsi->dev, "DSI: Failed to set display on: %d\n", ret);
+		return ret;
+	}
+
+	mtdsi_wait_power_mode(ctx, "display-on", MIPI_DCS_POWER_MODE_DISPLAY,
+			      MIPI_DCS_POWER_MODE_DISPLAY, 0, DISPLAY_ON_DELAY);
+	ctx->state = MTDSI_STATE_ON;
+
+	return 0;
+}
+
+/*
+ * With "motivo,gamma-from-crtc" the gamma LUT of the CRTC is fitted to the
+ * gamma taps of the panel, which then does the correction at no cost per
+ * frame. The LUT is read in the commit that enables the panel, a LUT
+ * change without a modeset is not seen. Going from a LUT to none puts the
+ * plain curve back.
+ */
+static int mtdsi_crtc_gamma(struct mtdsi *ctx)
+{
+	bool had = ctx->gamma_lut_set;
+
+	if (!ctx->gamma_crtc || ctx->state == MTDSI_STATE_OFF)
+		return 0;
+
+	ctx->gamma_lut_set = motivo_gamma_sample(ctx->connector, ctx->gamma_lut);
+	if (!ctx->gamma_lut_set && !had)
+		return 0;
+
+	mtdsi_retry_budget_start(ctx);
+
+	return mtdsi_write_gamma(ctx);
+}
+
+static int mtdsi_enable(struct drm_panel *panel)
+{
+	struct mtdsi *ctx = to_mtdsi(panel);
+	int ret = 0;
+
+	trace_motivo_panel_begin(panel->dev, "enable");
+
+	mtdsi_lock_yield(ctx);
+	ctx->enabled = true;
+
+	// The recovery worker turns the display on once the panel is back
+	if (ctx->health != MTDSI_HEALTH_OK)
+		goto out;
+
+	// Before display-on, so the first frame already has the curve
+	ret = mtdsi_crtc_gamma(ctx);
+	if (ret >= 0)
+		ret = mtdsi_power_on(ctx);
+	if (ret < 0) {
+		dev_err(panel->dev, "DSI: Failed to activate panel: %d\n", ret);
+		if (ctx->powered)
+			mtdsi_fail(ctx, ret);
+		goto out;
+	}
+
+	mtdsi_esd_schedule(ctx);
+
+out:
+	mutex_unlock(&ctx->lock);
+	trace_motivo_panel_end(panel->dev, "enable", ret);
+
+	return ret;
+}
+
+// Re-run the reset and init sequence, and display-on if DRM wants it
+static void mtdsi_recovery_work(struct work_struct *work)
+{
+	struct mtdsi *ctx = container_of(to_delayed_work(work), struct mtdsi,
+					 recovery_work);
+	int ret;
+
+	mutex_lock(&ctx->lock);
+	if (!ctx->powered || ctx->health == MTDSI_HEALTH_OK)
+		goto out;
+
+	ctx->health = MTDSI_HEALTH_RECOVERING;
+
+	ret = mtdsi_reset_and_init(ctx);
+	if (!ret && ctx->enabled)
+		ret = mtdsi_power_on(ctx);
+
+	// A callback took over, start again once it is done
+	if (ret == -ECANCELED) {
+		ctx->health = MTDSI_HEALTH_FAILED;
+		queue_delayed_work(system_long_wq, &ctx->recovery_work,
+				   msecs_to_jiffies(ctx->recovery_delay));
+		goto out;
+	}
+
+	if (ret < 0) {
+		ctx->recovery_failures++;
+		ctx->recovery_delay = min_t(unsigned int, ctx->recovery_delay * 2,
+					    RECOVERY_DELAY_MAX);
+		mtdsi_fail(ctx, ret);
+		goto out;
+	}
+
+	ctx->health = MTDSI_HEALTH_OK;
+	ctx->recoveries++;
+	ctx->last_recovery_ms = ktime_ms_delta(ktime_get(), ctx->failed_at);
+	dev_info(ctx->base.dev, "DSI: Panel recovered in %lld ms\n",
+		 ctx->last_recovery_ms);
+
+	if (ctx->enabled)
+		mtdsi_esd_schedule(ctx);
+
+out:
+	mutex_unlock(&ctx->lock);
+}
+
+// Catch ESD-style upsets: a lit panel must report sleep-out and display-on
+static void mtdsi_esd_work(struct work_struct *work)
+{
+	struct mtdsi *ctx = container_of(to_delayed_work(work), struct mtdsi,
+					 esd_work);
+	u8 mode = 0;
+	int ret;
+
+	mutex_lock(&ctx->lock);
+	if (!ctx->enabled || ctx->health != MTDSI_HEALTH_OK ||
+	    ctx->state != MTDSI_STATE_ON)
+		goto out;
+
+	ret = mipi_dsi_dcs_get_power_mode(ctx->dsi, &mode);
+	if (ret < 0 || (mode & MTDSI_POWER_MODE_ALIVE) != MTDSI_POWER_MODE_ALIVE) {
+		dev_warn(ctx->base.dev, "DSI: Power mode check failed (%d, 0x%02x)\n",
+			 ret, mode);
+		mtdsi_fail(ctx, ret < 0 ? ret : -EIO);
+		goto out;
+	}
+
+	mtdsi_esd_schedule(ctx);
+
+out:
+	mutex_unlock(&ctx->lock);
+}
+
+static int mtdsi_get_modes(struct drm_panel *panel,
+			      struct drm_connector *connector)
+{
+	struct mtdsi *ctx = to_mtdsi(panel);
+	struct drm_connector *old;
+	const struct drm_display_mode *m;
+	struct drm_display_mode *mode;
+	int count = 1;
+
+	// Identification may swap the description under the lock
+	mutex_lock(&ctx->lock);
+	// Held until the next get_modes or mtdsi_remove()
+	drm_connector_get(connector);
+	old = ctx->connector;
+	ctx->connector = connector;
+	m = ctx->desc->modes;
+
+	mode = drm_mode_duplicate(connector->dev, m);
+	if (!mode) {
+		dev_err(panel->dev, "DSI: Failed to add mode %ux%u@%u\n",
+			m->hdisplay, m->vdisplay, drm_mode_vrefresh(m));
+		mutex_unlock(&ctx->lock);
+		if (old)
+			drm_connector_put(old);
+		return -ENOMEM;
+	}
+
+	mode->type = DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED;
+	drm_mode_set_name(mode);
+	drm_mode_probed_add(connector, mode);
+
+	connector->display_info.width_mm = ctx->desc->size.width_mm;
+	connector->display_info.height_mm = ctx->desc->size.height_mm;
+	connector->display_info.bpc = min_t(unsigned int, ctx->desc->bpc,
+					    mipi_dsi_pixel_format_to_bpp(ctx->dsi->format) / 3);
+
+	// With motivo,standby-ms the modeset to one of these goes through the standby
+	count += motivo_add_low_refresh(connector, m, ctx->dsi->format, ctx->dsi->lanes);
+	mutex_unlock(&ctx->lock);
+
+	if (old)
+		drm_connector_put(old);
+
+	/*
+	 * TODO: Remove once all drm drivers call
+	 * drm_connector_set_orientation_from_panel()
+	 */
+
+	drm_connector_set_panel_orientation(connector, DRM_MODE_PANEL_ORIENTATION_LEFT_UP);
+
+	return count;
+}
+
+static enum drm_panel_orientation mtdsi_get_orientation(struct drm_panel *panel)
+{
+	struct mtdsi *ctx = to_mtdsi(panel);
+
+	return ctx->orientation;
+}
+
+static const struct drm_panel_funcs mtdsi_funcs = {
+	.disable = mtdsi_disable,
+	.unprepare = mtdsi_unprepare,
+	.prepare = mtdsi_prepare,
+	.enable = mtdsi_enable,
+	.get_modes = mtdsi_get_modes,
+	.get_orientation = mtdsi_get_orientation,
+};
+
+static const char * const mtdsi_health_names[] = {
+	[MTDSI_HEALTH_OK] = "ok",
+	[MTDSI_HEALTH_FAILED] = "failed",
+	[MTDSI_HEALTH_RECOVERING] = "recovering",
+};
+
+static ssize_t health_show(struct device *dev, struct device_attribute *attr,
+			   char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%s\n", mtdsi_health_names[READ_ONCE(ctx->health)]);
+}
+static DEVICE_ATTR_RO(health);
+
+static ssize_t recovery_count_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(ctx->recoveries));
+}
+static DEVICE_ATTR_RO(recovery_count);
+
+static ssize_t recovery_failures_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(ctx->recovery_failures));
+}
+static DEVICE_ATTR_RO(recovery_failures);
+
+static ssize_t last_recovery_ms_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%lld\n", READ_ONCE(ctx->last_recovery_ms));
+}
+static DEVICE_ATTR_RO(last_recovery_ms);
+
+static ssize_t page_switches_saved_show(struct device *dev,
+					struct device_attribute *attr, char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(ctx->page_skips));
+}
+static DEVICE_ATTR_RO(page_switches_saved);
+
+/*
+ * Duration of the last init sequence sent in each mode, 0 if none was.
+ * Booting once with "motivo,init-hs" and once without gives both.
+ */
+static ssize_t init_hs_us_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%lld\n", READ_ONCE(ctx->init_us[1]));
+}
+static DEVICE_ATTR_RO(init_hs_us);
+
+static ssize_t init_lp_us_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%lld\n", READ_ONCE(ctx->init_us[0]));
+}
+static DEVICE_ATTR_RO(init_lp_us);
+
+/*
+ * The panel curve in the format of motivo_gamma_parse(). With
+ * "motivo,gamma-from-crtc" it is the curve the CRTC LUT is fitted onto.
+ */
+static ssize_t gamma_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+	u8 gamma[2 * MOTIVO_GAMMA_TAPS];
+	bool ok = true;
+
+	mutex_lock(&ctx->lock);
+	if (ctx->gamma_set)
+		memcpy(gamma, ctx->gamma, sizeof(gamma));
+	else
+		ok = mtdsi_gamma_defaults(ctx, gamma);
+	mutex_unlock(&ctx->lock);
+
+	return ok ? motivo_gamma_show(buf, gamma) : -ENODATA;
+}
+
+static ssize_t gamma_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+	u8 gamma[2 * MOTIVO_GAMMA_TAPS];
+	int set, ret = 0;
+
+	set = motivo_gamma_parse(buf, gamma);
+	if (set < 0)
+		return set;
+
+	mutex_lock(&ctx->lock);
+
+	// Also checks that the init program sets the gamma at all
+	if (!mtdsi_gamma_defaults(ctx, ctx->gamma)) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	if (set)
+		memcpy(ctx->gamma, gamma, sizeof(gamma));
+	ctx->gamma_set = set;
+
+	// A panel that is off gets the curve with its next init
+	if (ctx->powered && ctx->state != MTDSI_STATE_OFF &&
+	    ctx->health == MTDSI_HEALTH_OK) {
+		mtdsi_retry_budget_start(ctx);
+		ret = mtdsi_write_gamma(ctx);
+	}
+
+out:
+	mutex_unlock(&ctx->lock);
+
+	return ret < 0 ? ret : count;
+}
+static DEVICE_ATTR_RW(gamma);
+
+static const char * const mtdsi_cabc_names[] = {
+	"off", "ui", "still", "moving",
+};
+
+// Last CABC mode the init program sets, if any
+static int mtdsi_table_cabc(struct mtdsi *ctx)
+{
+	const u8 *op;
+	int page = 0, cabc = -ENODATA;
+
+	for (op = ctx->init_cmds; op[0] != MTDSI_OP_END; op = mtdsi_op_next(op)) {
+		if (mtdsi_is_switch_page(op))
+			page = op[5];
+		else if (page == 0 && mtdsi_is_reg_write(op) &&
+			 op[2] == MIPI_DCS_WRITE_POWER_SAVE)
+			cabc = op[3];
+	}
+
+	return cabc;
+}
+
+/*
+ * Content adaptive backlight control (DCS 55h). Changing it is one DCS
+ * write on a running panel, and none if the panel already has that mode.
+ */
+static ssize_t cabc_show(struct device *dev, struct device_attribute *attr,
+			 char *buf)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+	int cabc;
+
+	mutex_lock(&ctx->lock);
+	cabc = ctx->cabc >= 0 ? ctx->cabc : mtdsi_table_cabc(ctx);
+	mutex_unlock(&ctx->lock);
+
+	if (cabc < 0)
+		return cabc;
+	if (cabc >= ARRAY_SIZE(mtdsi_cabc_names))
+		return sysfs_emit(buf, "0x%02x\n", cabc);
+
+	return sysfs_emit(buf, "%s\n", mtdsi_cabc_names[cabc]);
+}
+
+static ssize_t cabc_store(struct device *dev, struct device_attribute *attr,
+			  const char *buf, size_t count)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+	u8 cabc;
+	int ret;
+
+	ret = sysfs_match_string(mtdsi_cabc_names, buf);
+	if (ret < 0)
+		return ret;
+	cabc = ret;
+
+	mutex_lock(&ctx->lock);
+
+	ctx->cabc = cabc;
+	ret = 0;
+	if (ctx->powered && ctx->state != MTDSI_STATE_OFF &&
+	    ctx->health == MTDSI_HEALTH_OK) {
+		mtdsi_retry_budget_start(ctx);
+		ret = mtdsi_update_regs(ctx, 0, MIPI_DCS_WRITE_POWER_SAVE, &cabc, 1);
+	}
+
+	mutex_unlock(&ctx->lock);
+
+	return ret < 0 ? ret : count;
+}
+static DEVICE_ATTR_RW(cabc);
+
+static struct attribute *mtdsi_attrs[] = {
+	&dev_attr_health.attr,
+	&dev_attr_recovery_count.attr,
+	&dev_attr_recovery_failures.attr,
+	&dev_attr_last_recovery_ms.attr,
+	&dev_attr_page_switches_saved.attr,
+	&dev_attr_init_hs_us.attr,
+	&dev_attr_init_lp_us.attr,
+	&dev_attr_gamma.attr,
+	&dev_attr_cabc.attr,
+	NULL
+};
+
+static const struct attribute_group mtdsi_attr_group = {
+	.attrs = mtdsi_attrs,
+};
+
+static int mtdsi_add(struct mtdsi *ctx)
+{
+	struct device *dev = &ctx->dsi->dev;
+	int err;
+
+	ctx->power = devm_regulator_get(dev, "power");
+	if (IS_ERR(ctx->power))
+		return PTR_ERR(ctx->power);
+
+	// Keep a panel lit by the firmware out of reset until it is checked
+	ctx->reset = devm_gpiod_get_optional(dev, "reset",
+					     ctx->handoff ? GPIOD_ASIS : GPIOD_OUT_LOW);
+	if (IS_ERR(ctx->reset)) {
+		dev_err(dev, "DSI: Cannot get reset-gpios %ld\n",
+			PTR_ERR(ctx->reset));
+		return PTR_ERR(ctx->reset);
+	}
+
+	if (!ctx->handoff)
+		gpiod_set_value_cansleep(ctx->reset, 0);
+
+	drm_panel_init(&ctx->base, dev, &mtdsi_funcs,
+		       DRM_MODE_CONNECTOR_DSI);
+	err = of_drm_get_panel_orientation(dev->of_node, &ctx->orientation);
+	if (err < 0) {
+		dev_err(dev, "DSI: %pOF: Failed to get orientation %d\n", dev->of_node, err);
+		return err;
+	}
+
+	err = drm_panel_of_backlight(&ctx->base);
+	if (err)
+		return err;
+
+	ctx->base.funcs = &mtdsi_funcs;
+	ctx->base.dev = &ctx->dsi->dev;
+
+	ctx->base.prepare_prev_first = true;
+
+	drm_panel_add(&ctx->base);
+
+	return 0;
+}
+
+// Check an init stream from outside the driver before it is ever sent
+static int mtdsi_validate_init(const u8 *op, size_t len)
+{
+	const u8 *end = op + len;
+
+	while (op < end && op[0] != MTDSI_OP_END) {
+		if (end - op < MTDSI_OP_HDR + 1 || end - op < MTDSI_OP_HDR + op[1] + 1)
+			return -EINVAL;
+
+		switch (op[0]) {
+		case MTDSI_OP_DCS:
+			if (!op[1])
+				return -EINVAL;
+			break;
+		case MTDSI_OP_DELAY:
+			if (op[1] != 1)
+				return -EINVAL;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		op = mtdsi_op_next(op);
+	}
+
+	// The terminator has to be the last byte
+	return op == end - 1 ? 0 : -EINVAL;
+}
+
+#define MTDSI_REORDER_PAGES	8
+
+static u8 *mtdsi_put_op(u8 *out, const u8 *op)
+{
+	size_t len = MTDSI_OP_HDR + op[1];
+
+	memcpy(out, op, len);
+
+	return out + len;
+}
+
+/*
+ * Group the vendor page writes of a script by page so each page is switched
+ * to once. A group ends on a switch to page 0, a delay or the end of the
+ * script: page 0 holds the DCS commands, whose order matters. Writes keep
+ * their order within a page. Returns the number of page switches saved.
+ */
+static unsigned int mtdsi_reorder_init(u8 *out, const u8 *op)
+{
+	u8 pages[MTDSI_REORDER_PAGES];
+	unsigned int np, k, before = 0, after = 0;
+	const u8 *run, *end, *o;
+	int cur = 0;
+
+	while (op[0] != MTDSI_OP_END) {
+		if (!mtdsi_is_switch_page(op) || !op[5]) {
+			if (mtdsi_is_switch_page(op)) {
+				cur = op[5];
+				before++;
+				after++;
+			}
+			out = mtdsi_put_op(out, op);
+			op = mtdsi_op_next(op);
+			continue;
+		}
+
+		// Find the group and its pages, in order of first use
+		np = 0;
+		for (end = op; end[0] == MTDSI_OP_DCS; end = mtdsi_op_next(end)) {
+			if (!mtdsi_is_switch_page(end))
+				continue;
+			if (!end[5])
+				break;
+
+			for (k = 0; k < np && pages[k] != end[5]; k++)
+				;
+			if (k == np) {
+				if (np == MTDSI_REORDER_PAGES)
+					break;
+				pages[np++] = end[5];
+			}
+			before++;
+		}
+
+		run = op;
+		for (k = 0; k < np; k++) {
+			const u8 sw[] = { _INIT_SWITCH_PAGE_CMD(pages[k]) };
+
+			out = mtdsi_put_op(out, sw);
+			after++;
+
+			for (o = run; o < end; o = mtdsi_op_next(o)) {
+				if (mtdsi_is_switch_page(o))
+					cur = o[5];
+				else if (cur == pages[k])
+					out = mtdsi_put_op(out, o);
+			}
+		}
+
+		// Leave the controller on the page the script expects next
+		if (cur != pages[np - 1]) {
+			const u8 sw[] = { _INIT_SWITCH_PAGE_CMD(cur) };
+
+			out = mtdsi_put_op(out, sw);
+			after++;
+		}
+
+		op = end;
+	}
+
+	*out = MTDSI_OP_END;
+
+	return before - after;
+}
+
+// Redirected by the KUnit suite, which has no firmware to load
+static int mtdsi_request_script(const struct firmware **fw, const char *name,
+				struct device *dev)
+{
+	KUNIT_STATIC_STUB_REDIRECT(mtdsi_request_script, fw, name, dev);
+
+	return firmware_request_nowarn(fw, name, dev);
+}
+
+/*
+ * Look for an init script for this panel's variant, motivo/<variant>.bin.
+ * It is parsed once here, or once more when "motivo,auto" identifies
+ * another variant, and the validated stream is kept for every prepare.
+ */
+static void mtdsi_load_init_script(struct mtdsi *ctx)
+{
+	struct device *dev = &ctx->dsi->dev;
+	const struct mtdsi_fw_header *hdr;
+	const struct firmware *fw;
+	const char *variant;
+	char name[64];
+	const u8 *data;
+	u8 *script;
+	u32 len;
+	int ret;
+
+	ctx->init_cmds = ctx->desc->init_cmds;
+
+	variant = mtdsi_variant_name(ctx->desc);
+	if (!variant)
+		return;
+
+	snprintf(name, sizeof(name), "motivo/%s.bin", variant);
+
+	if (mtdsi_request_script(&fw, name, dev))
+		return;
+
+	ret = -EINVAL;
+	if (fw->size < sizeof(*hdr))
+		goto out;
+
+	hdr = (const struct mtdsi_fw_header *)fw->data;
+	data = fw->data + sizeof(*hdr);
+	len = le32_to_cpu(hdr->length);
+
+	if (le32_to_cpu(hdr->magic) != MTDSI_FW_MAGIC ||
+	    le16_to_cpu(hdr->version) != MTDSI_FW_VERSION) {
+		dev_warn(dev, "DSI: %s: unsupported init script format\n", name);
+		goto out;
+	}
+
+	if (len > MTDSI_FW_MAX || len != fw->size - sizeof(*hdr) ||
+	    (crc32_le(~0, data, len) ^ ~0) != le32_to_cpu(hdr->crc)) {
+		dev_warn(dev, "DSI: %s: truncated or corrupt init script\n", name);
+		goto out;
+	}
+
+	ret = mtdsi_validate_init(data, len);
+	if (ret < 0) {
+		dev_warn(dev, "DSI: %s: malformed init commands\n", name);
+		goto out;
+	}
+
+	script = devm_kmalloc(dev, len, GFP_KERNEL);
+	if (!script) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (of_property_read_bool(dev->of_node, "motivo,reorder-init"))
+		dev_info(dev, "DSI: Reordered init script saves %u page switches\n",
+			 mtdsi_reorder_init(script, data));
+	else
+		memcpy(script, data, len);
+
+	ctx->init_cmds = script;
+	dev_info(dev, "DSI: Using init script %s revision %u\n", name,
+		 le16_to_cpu(hdr->revision));
+
+out:
+	if (ret < 0)
+		dev_warn(dev, "DSI: Using built-in init sequence\n");
+	release_firmware(fw);
+}
+
+/*
+ * The defaults are sized for the slowest panel revision seen so far. A
+ * product that only ships faster ones can trim them from the overlay, down
+ * to what the ILI9881C datasheet allows: a reset pulse of 1 ms, the
+ * property's unit (the datasheet asks for 10 us), 5 ms before the first
+ * command after reset or sleep-out, and a frame to blank after sleep-in
+ * before the rail goes. Sleep-out only gates display-on here, the 120 ms
+ * before a sleep-in is SLEEP_GUARD and cannot be trimmed.
+ */
+static void mtdsi_parse_timings(struct mtdsi *ctx)
+{
+	struct device *dev = &ctx->dsi->dev;
+	struct mtdsi_timings *t = &ctx->timing;
+
+	t->reset_low_ms = motivo_read_timing(dev, "motivo,reset-low-ms",
+					     RESET_LOW, 1,
+					     MOTIVO_TIMING_MAX_MS);
+	t->reset_recovery_us = motivo_read_timing(dev, "motivo,reset-recovery-us",
+						  RESET_DELAY * 1000,
+						  CMD_DELAY * 1000,
+						  MOTIVO_TIMING_MAX_MS * 1000);
+	t->sleep_out_ms = motivo_read_timing(dev, "motivo,sleep-out-ms",
+					     SLEEP_OUT_DELAY, CMD_DELAY,
+					     MOTIVO_TIMING_MAX_MS);
+	t->sleep_in_ms = motivo_read_timing(dev, "motivo,sleep-in-ms",
+					    SLEEP_IN_DELAY, 20,
+					    MOTIVO_TIMING_MAX_MS);
+	t->retry_delay_ms = motivo_read_timing(dev, "motivo,retry-delay-ms",
+					       RETRY_DELAY, 10,
+					       MOTIVO_TIMING_MAX_MS);
+}
+
+// The variant a "motivo,auto" node also claims compatibility with
+static const struct panel_desc *mtdsi_auto_fallback(struct device_node *np)
+{
+	char compatible[32];
+	unsigned int i;
+
+	KUNIT_STATIC_STUB_REDIRECT(mtdsi_auto_fallback, np);
+
+	for (i = 0; i < ARRAY_SIZE(mtdsi_variants); i++) {
+		snprintf(compatible, sizeof(compatible), "motivo,%s",
+			 mtdsi_variants[i].name);
+		if (of_device_is_compatible(np, compatible))
+			return mtdsi_variants[i].desc;
+	}
+
+	return NULL;
+}
+
+// The variant of the compatible @dsi was bound for, NULL for "motivo,auto"
+static const struct panel_desc *mtdsi_match_desc(struct mipi_dsi_device *dsi)
+{
+	KUNIT_STATIC_STUB_REDIRECT(mtdsi_match_desc, dsi);
+
+	return of_device_get_match_data(&dsi->dev);
+}
+
+static int mtdsi_probe(struct mipi_dsi_device *dsi)
+{
+	struct mtdsi *ctx;
+	int ret;
+	const struct panel_desc *desc;
+	u32 standby_ms = 0;
+
+	ctx = devm_kzalloc(&dsi->dev, sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	desc = mtdsi_match_desc(dsi);
+	if (!desc) {
+		// "motivo,auto": identified on the first prepare
+		ctx->fallback = mtdsi_auto_fallback(dsi->dev.of_node);
+		desc = ctx->fallback ?: &mt1280800a_desc;
+		ctx->detect_pending = true;
+	}
 
-	desc = of_device_get_match_data(&dsi->dev);
 	dsi->lanes = desc->lanes;
 	dsi->format = desc->format;
 	dsi->mode_flags = desc->mode_flags;
 	ctx->desc = desc;
 	ctx->dsi = dsi;
-	ret = mtdsi_add(ctx);
+	ctx->page = -1;
+	ctx->cabc = -1;
+	// A format the link cannot carry leaves the table's
+	if (motivo_parse_format(&dsi->dev, desc->modes, dsi->lanes, &dsi->format))
+		dev_warn(&dsi->dev, "DSI: Keeping the table pixel format\n");
+
+	ctx->init_hs = desc->init_hs;
+	if (of_property_read_bool(dsi->dev.of_node, "motivo,init-hs"))
+		ctx->init_hs = true;
+	if (of_property_read_bool(dsi->dev.of_node, "motivo,init-lp"))
+		ctx->init_hs = false;
+	ctx->poll_ready = !of_property_read_bool(dsi->dev.of_node, "motivo,fixed-delays");
+	of_property_read_u32(dsi->dev.of_node, "motivo,esd-check-ms", &ctx->esd_period);
+	if (ctx->esd_period && ctx->esd_period < ESD_CHECK_MIN) {
+		dev_warn(&dsi->dev, "DSI: motivo,esd-check-ms of %u is below the %u minimum, ESD check disabled\n",
+			 ctx->esd_period, ESD_CHECK_MIN);
+		ctx->esd_period = 0;
+	}
+	ctx->prune = of_property_read_bool(dsi->dev.of_node, "motivo,prune-defaults");
+	ctx->standby_ok = !of_property_read_u32(dsi->dev.of_node, "motivo,standby-ms",
+						&standby_ms);
+	ctx->handoff = of_property_read_bool(dsi->dev.of_node, "motivo,boot-on");
+	ctx->prune_verify = of_property_read_bool(dsi->dev.of_node, "motivo,prune-verify");
+	ctx->gamma_crtc = of_property_read_bool(dsi->dev.of_node, "motivo,gamma-from-crtc");
+	mtdsi_parse_timings(ctx);
+
+	mtdsi_load_init_script(ctx);
+
+	mutex_init(&ctx->lock);
+	INIT_WORK(&ctx->hotplug_work, mtdsi_hotplug_work);
+	INIT_DELAYED_WORK(&ctx->recovery_work, mtdsi_recovery_work);
+	INIT_DELAYED_WORK(&ctx->esd_work, mtdsi_esd_work);
+
+	mipi_dsi_set_drvdata(dsi, ctx);
+
+	pm_runtime_set_autosuspend_delay(&dsi->dev, standby_ms);
+	pm_runtime_use_autosuspend(&dsi->dev);
+	ret = devm_pm_runtime_enable(&dsi->dev);
 	if (ret < 0)
 		return ret;
 
-	mipi_dsi_set_drvdata(dsi, ctx);
+	ret = devm_device_add_group(&dsi->dev, &mtdsi_attr_group);
+	if (ret < 0)
+		return ret;
+
+	ret = mtdsi_add(ctx);
+	if (ret < 0)
+		return ret;
 
 	ret = mipi_dsi_attach(dsi);
 	if (ret)
@@ -902,31 +2803,138 @@ static void mtdsi_remove(struct mipi_dsi_device *dsi)
 	struct mtdsi *ctx = mipi_dsi_get_drvdata(dsi);
 	int ret;
 
+	// The workers talk to the host and the panel, stop them before either goes
+	mtdsi_lock_yield(ctx);
+	ctx->enabled = false;
+	ctx->health = MTDSI_HEALTH_OK;
+	mutex_unlock(&ctx->lock);
+
+	cancel_work_sync(&ctx->hotplug_work);
+	cancel_delayed_work_sync(&ctx->esd_work);
+	mtdsi_recovery_cancel(ctx);
+
 	ret = mipi_dsi_detach(dsi);
 	if (ret < 0)
 		dev_err(&dsi->dev, "DSI: Failed to detach from DSI host: %d\n", ret);
 
 	if (ctx->base.dev)
 		drm_panel_remove(&ctx->base);
+
+	// Do not leave the supply on for a panel parked in standby
+	mutex_lock(&ctx->lock);
+	mtdsi_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+
+	if (ctx->connector)
+		drm_connector_put(ctx->connector);
+	ctx->connector = NULL;
+}
+
+/*
+ * Reboot and poweroff. The panel goes down in the controller's order,
+ * display-off, sleep-in and then the rail, but without the retries and
+ * fixed delays of mtdsi_disable(): a panel that does not answer loses its
+ * supply all the same. DRM may still disable the panel afterwards, which
+ * then finds it off.
+ */
+static void mtdsi_shutdown(struct mipi_dsi_device *dsi)
+{
+	struct mtdsi *ctx = mipi_dsi_get_drvdata(dsi);
+	struct device *dev = &dsi->dev;
+
+	trace_motivo_panel_begin(dev, "shutdown");
+
+	cancel_work_sync(&ctx->hotplug_work);
+	cancel_delayed_work_sync(&ctx->esd_work);
+	mtdsi_recovery_cancel(ctx);
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->powered && ctx->health == MTDSI_HEALTH_OK &&
+	    ctx->state >= MTDSI_STATE_AWAKE) {
+		dsi->mode_flags &= ~MIPI_DSI_MODE_LPM;
+		ctx->retry_deadline = ktime_get();
+
+		if (ctx->state == MTDSI_STATE_ON)
+			mtdsi_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_OFF);
+
+		mtdsi_wait_until(ctx, "sleep-out", ctx->sleep_in_ok);
+		if (!mtdsi_dcs_cmd(ctx, MIPI_DCS_ENTER_SLEEP_MODE))
+			mtdsi_wait_power_mode(ctx, "sleep-in",
+					      MIPI_DCS_POWER_MODE_SLEEP | MTDSI_POWER_MODE_BOOSTER,
+					      0, CMD_DELAY, ctx->timing.sleep_in_ms);
+	}
+
+	ctx->health = MTDSI_HEALTH_OK;
+	mtdsi_power_off(ctx);
+
+	mutex_unlock(&ctx->lock);
+
+	trace_motivo_panel_end(dev, "shutdown", 0);
 }
 
 static const struct of_device_id mtdsi_of_match[] = {
 	{ .compatible = "motivo,mt1280800a", .data = &mt1280800a_desc },
 	{ .compatible = "motivo,mt1280800b", .data = &mt1280800b_desc },
+	{ .compatible = "motivo,auto" },
 	{ /* sentinel */ }
 };
 MODULE_DEVICE_TABLE(of, mtdsi_of_match);
 
+/*
+ * System sleep. The panel is registered after the vc4 DRM device and so
+ * suspends before it, still prepared: the unprepare of DRM's suspend
+ * commit comes later, with runtime PM about to be disabled. From here on
+ * unprepare powers the panel off instead of parking it, as the standby
+ * timer would not run, and a standby already parked is dropped now.
+ */
+static int mtdsi_suspend(struct device *dev)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	ctx->suspended = true;
+	if (ctx->standby)
+		mtdsi_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
+// The power-up is left to the prepare of DRM's resume commit
+static int mtdsi_resume(struct device *dev)
+{
+	struct mtdsi *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	ctx->suspended = false;
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
+// Runtime PM only parks and drops the supply, see mtdsi_runtime_suspend()
+static const struct dev_pm_ops mtdsi_pm_ops = {
+	SYSTEM_SLEEP_PM_OPS(mtdsi_suspend, mtdsi_resume)
+	RUNTIME_PM_OPS(mtdsi_runtime_suspend, mtdsi_runtime_resume, NULL)
+};
+
 static struct mipi_dsi_driver mtdsi_driver = {
 	.driver = {
 		.name = "panel-dsi-mt",
 		.of_match_table = mtdsi_of_match,
+		.pm = pm_ptr(&mtdsi_pm_ops),
 	},
 	.probe = mtdsi_probe,
 	.remove = mtdsi_remove,
+	.shutdown = mtdsi_shutdown,
 };
 module_mipi_dsi_driver(mtdsi_driver);
 
 MODULE_AUTHOR("Andrew Seredyn <andser@gmail.com>");
 MODULE_DESCRIPTION("DRM Driver for MOTIVO MIPI DSI panels.");
 MODULE_LICENSE("GPL v2");
+
+#if IS_ENABLED(CONFIG_DRM_PANEL_MOTIVO_KUNIT_TEST)
+#include "panel-dsi-mt-test.c"
+#endif
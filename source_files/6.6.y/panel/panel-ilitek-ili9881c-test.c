@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit suite for the ILI9881C driver. It is included at the end of the
+ * driver, so it binds the real probe and runs the panel callbacks and init
+ * tables against the fake host of panel-motivo-test.h, once for each
+ * compatible in ili9881c_of_match.
+ *
+ *   ./tools/testing/kunit/kunit.py run --kunitconfig=drivers/gpu/drm/panel
+ */
+#include "panel-motivo-test.h"
+
+static const void *ili9881c_test_gen_params(const void *prev, char *desc)
+{
+	return motivo_test_next_id(prev, desc, ili9881c_of_match);
+}
+
+static const struct ili9881c_desc *
+ili9881c_test_match_desc(struct mipi_dsi_device *dsi)
+{
+	return motivo_test_match_data();
+}
+
+static int ili9881c_test_init(struct kunit *test)
+{
+	kunit_activate_static_stub(test, ili9881c_match_desc,
+				   ili9881c_test_match_desc);
+
+	return motivo_test_init(test, "ili9881c-test", ili9881c_dsi_probe);
+}
+
+static void ili9881c_test_exit(struct kunit *test)
+{
+	motivo_test_exit(test, ili9881c_dsi_remove);
+}
+
+static int ili9881c_test_on(struct kunit *test, const char *what)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	return motivo_test_on(test, &ctx->panel, what);
+}
+
+static void ili9881c_test_off(struct kunit *test, const char *what)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	motivo_test_off(test, &ctx->panel, what);
+
+	if (!(ctx->desc->flags & ILI9881_FLAGS_NO_SHUTDOWN_CMDS)) {
+		KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+		KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_SLEEP);
+	}
+}
+
+static void ili9881c_test_expect_on(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	KUNIT_EXPECT_TRUE(test, ctx->powered);
+	KUNIT_EXPECT_EQ(test, h->page, 0);
+	KUNIT_EXPECT_TRUE(test, h->mode & MIPI_DCS_POWER_MODE_SLEEP);
+	KUNIT_EXPECT_TRUE(test, h->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+}
+
+static void ili9881c_test_power_cycle(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "power on"), 0);
+	ili9881c_test_expect_on(test);
+	KUNIT_EXPECT_GT(test, h->writes, 0);
+
+	ili9881c_test_off(test, "power off");
+}
+
+/* A modeset within the autosuspend delay wakes the panel without an init */
+static void ili9881c_test_standby(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+	unsigned int cold;
+
+	if (ctx->desc->flags & ILI9881_FLAGS_NO_SHUTDOWN_CMDS)
+		kunit_skip(test, "panel is never sent to sleep");
+
+	/* As with motivo,standby-ms */
+	ctx->standby_ok = true;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "cold on"), 0);
+	cold = h->writes;
+	ili9881c_test_off(test, "to standby");
+	KUNIT_EXPECT_TRUE(test, ctx->standby);
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "warm on"), 0);
+	ili9881c_test_expect_on(test);
+	KUNIT_EXPECT_LT(test, h->writes, cold);
+	KUNIT_EXPECT_EQ(test, h->page_switches, 0);
+
+	ili9881c_test_off(test, "power off");
+}
+
+/* System sleep comes before DRM's unprepare, which must then power off */
+static void ili9881c_test_suspend(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	ctx->standby_ok = true;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "power on"), 0);
+	KUNIT_EXPECT_EQ(test, ili9881c_suspend(&h->dsi->dev), 0);
+	ili9881c_test_off(test, "suspend commit");
+	KUNIT_EXPECT_FALSE(test, ctx->standby);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	KUNIT_EXPECT_EQ(test, ili9881c_resume(&h->dsi->dev), 0);
+}
+
+/*
+ * There is no retry, a failed write fails the prepare. The supply is off
+ * again straight away, the unprepare that follows has nothing to send, and
+ * the next prepare starts over.
+ */
+static void ili9881c_test_write_failure(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+
+	h->fail_at = 2;
+	h->fail_count = 1;
+	h->fail_err = -EIO;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "power on, failed"), -EIO);
+	KUNIT_EXPECT_EQ(test, h->failures, 1);
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+
+	motivo_test_reset_counts(h);
+	KUNIT_EXPECT_EQ(test, drm_panel_disable(&ctx->panel), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_unprepare(&ctx->panel), 0);
+	KUNIT_EXPECT_EQ(test, h->writes, 0);
+	KUNIT_EXPECT_FALSE(test, ctx->active);
+
+	h->fail_at = 0;
+	motivo_test_hw_reset(h);
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "power on"), 0);
+	ili9881c_test_expect_on(test);
+
+	ili9881c_test_off(test, "power off");
+}
+
+/* A controller without auto-increment gets single writes from the first burst on */
+static void ili9881c_test_burst_fallback(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+	const struct ili9881c_instr *init = ctx->desc->init;
+	unsigned int i;
+	u8 page = 0;
+
+	if (!(ctx->desc->flags & ILI9881_FLAGS_BURST_WRITES))
+		kunit_skip(test, "panel sends single writes");
+
+	h->no_burst = true;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "no auto-increment"), 0);
+	ili9881c_test_expect_on(test);
+	KUNIT_EXPECT_EQ(test, ctx->burst, ILI9881C_BURST_BROKEN);
+
+	/* Each vendor register holds what the last init write to it left there */
+	for (i = 0; i < ctx->desc->init_length; i++) {
+		if (init[i].op == ILI9881C_SWITCH_PAGE)
+			page = init[i].page;
+		else if (page && page < MOTIVO_TEST_PAGES &&
+			 ili9881c_last_write(ctx, i, page))
+			KUNIT_EXPECT_EQ(test, h->regs[page][init[i].cmd],
+					init[i].data);
+	}
+
+	ili9881c_test_off(test, "power off");
+}
+
+/* Timings trimmed to the controller minimums shorten a cold power-up */
+static void ili9881c_test_timings(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+	unsigned int slow;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "default timings"), 0);
+	slow = h->delay_ms;
+	ili9881c_test_off(test, "power off");
+	motivo_test_hw_reset(h);
+
+	ctx->timing = (struct ili9881c_timings) {
+		.power_on_ms = 1,
+		.reset_low_ms = 1,
+		.reset_recovery_us = 5000,
+		.sleep_out_ms = 5,
+	};
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "trimmed timings"), 0);
+	ili9881c_test_expect_on(test);
+	KUNIT_EXPECT_LT(test, h->delay_ms, slow);
+
+	/* Only display-on is brought forward, sleep-in keeps its guard */
+	KUNIT_EXPECT_GE(test,
+			ktime_ms_delta(ctx->sleep_in_ok, ctx->sleep_out_done),
+			ILI9881C_SLEEP_GUARD_MS - ctx->timing.sleep_out_ms);
+
+	ili9881c_test_off(test, "power off");
+}
+
+/* Shutdown takes a lit panel down, the DRM disable after it sends nothing */
+static void ili9881c_test_shutdown(struct kunit *test)
+{
+	struct motivo_test_host *h = test->priv;
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(h->dsi);
+	ktime_t start;
+
+	KUNIT_EXPECT_EQ(test, ili9881c_test_on(test, "power on"), 0);
+
+	motivo_test_reset_counts(h);
+	start = ktime_get();
+	ili9881c_dsi_shutdown(h->dsi);
+	motivo_test_report(test, h, "shutdown", ktime_us_delta(ktime_get(), start));
+
+	KUNIT_EXPECT_FALSE(test, ctx->powered);
+	KUNIT_EXPECT_FALSE(test, ctx->standby);
+	if (!(ctx->desc->flags & ILI9881_FLAGS_NO_SHUTDOWN_CMDS)) {
+		KUNIT_EXPECT_EQ(test, h->writes, 2);
+		KUNIT_EXPECT_GE(test, h->delay_ms, ILI9881C_SLEEP_GUARD_MS);
+		KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_DISPLAY);
+		KUNIT_EXPECT_FALSE(test, h->mode & MIPI_DCS_POWER_MODE_SLEEP);
+	}
+
+	motivo_test_reset_counts(h);
+	KUNIT_EXPECT_EQ(test, drm_panel_disable(&ctx->panel), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_unprepare(&ctx->panel), 0);
+	KUNIT_EXPECT_EQ(test, h->writes, 0);
+}
+
+static struct kunit_case ili9881c_test_cases[] = {
+	MOTIVO_TEST_CASES(ili9881c),
+	KUNIT_CASE_PARAM(ili9881c_test_write_failure, ili9881c_test_gen_params),
+	KUNIT_CASE_PARAM(ili9881c_test_burst_fallback, ili9881c_test_gen_params),
+	{}
+};
+
+static struct kunit_suite ili9881c_test_suite = {
+	.name = "panel-ilitek-ili9881c",
+	.init = ili9881c_test_init,
+	.exit = ili9881c_test_exit,
+	.test_cases = ili9881c_test_cases,
+};
+kunit_test_suite(ili9881c_test_suite);
@@ -7,13 +7,20 @@
  * Copyright (C) 2023, Dario Murgia <dario@volumio.org>
  */
 
+#include <kunit/static_stub.h>
+
+#include <linux/bitmap.h>
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
+#include <linux/pm_runtime.h>
+#include <linux/sysfs.h>
 
 #include <linux/gpio/consumer.h>
 #include <linux/regulator/consumer.h>
@@ -24,29 +31,57 @@
 
 #include <video/mipi_display.h>
 
+#include "panel-motivo.h"
+#include "panel-motivo-trace.h"
+
 enum ili9881c_op {
 	ILI9881C_SWITCH_PAGE,
 	ILI9881C_COMMAND,
 };
 
+/*
+ * Init tables are packed three bytes per instruction, so each of them is a
+ * single contiguous opcode/payload stream instead of padded enum/union pairs.
+ */
 struct ili9881c_instr {
-	enum ili9881c_op	op;
-
-	union arg {
-		struct cmd {
-			u8	cmd;
-			u8	data;
-		} cmd;
+	u8	op;			/* enum ili9881c_op */
+	union {
+		u8	cmd;
 		u8	page;
-	} arg;
+	};
+	u8	data;
 };
 
+static_assert(sizeof(struct ili9881c_instr) == 3);
+
 enum ili9881_desc_flags {
 	ILI9881_FLAGS_NO_SHUTDOWN_CMDS = BIT(0),
 	ILI9881_FLAGS_PANEL_ON_IN_PREPARE = BIT(1),
+	ILI9881_FLAGS_BURST_WRITES = BIT(2),
+	ILI9881_FLAGS_LOW_REFRESH = BIT(3),
 	ILI9881_FLAGS_MAX = BIT(31),
 };
 
+/* Registers per coalesced write, see ili9881c_send_burst() */
+#define ILI9881C_BURST_MAX	16
+
+/*
+ * Last value written to each register of the first command pages, so that
+ * runtime changes only send what differs. Dropped on reset and power off.
+ */
+#define ILI9881C_SHADOW_PAGES	8
+
+struct ili9881c_shadow {
+	u8		val[ILI9881C_SHADOW_PAGES][256];
+	DECLARE_BITMAP(valid, ILI9881C_SHADOW_PAGES * 256);
+};
+
+enum ili9881c_burst {
+	ILI9881C_BURST_UNTESTED,
+	ILI9881C_BURST_OK,
+	ILI9881C_BURST_BROKEN,
+};
+
 struct ili9881c_desc {
 	const struct ili9881c_instr *init;
 	const size_t init_length;
@@ -56,6 +91,14 @@ struct ili9881c_desc {
 	enum ili9881_desc_flags flags;
 };
 
+/* Power sequence delays, the ILI9881C_* defaults unless the DT overrides them */
+struct ili9881c_timings {
+	unsigned int		power_on_ms;
+	unsigned int		reset_low_ms;
+	unsigned int		reset_recovery_us;
+	unsigned int		sleep_out_ms;
+};
+
 struct ili9881c {
 	struct drm_panel	panel;
 	struct mipi_dsi_device	*dsi;
@@ -65,25 +108,74 @@ struct ili9881c {
 	struct gpio_desc	*reset;
 
 	enum drm_panel_orientation	orientation;
+	enum mipi_dsi_pixel_format	format;
+
+	enum ili9881c_burst	burst;
+
+	/* Serialises the panel callbacks with gamma writes from sysfs */
+	struct mutex		lock;
+	bool			powered;
+
+	int			page;		/* -1 when unknown */
+	unsigned int		page_skips;
+	struct ili9881c_shadow	shadow;
+
+	bool			handoff;	/* May have been lit by the firmware */
+
+	/* Asleep but initialised until autosuspend, see ili9881c_unprepare() */
+	bool			standby;
+	bool			standby_ok;
+	bool			active;		/* Holds a runtime PM reference */
+	bool			suspended;	/* See ili9881c_suspend() */
+
+	/* Defaults-aware init, see motivo_prune_check() */
+	bool			prune;
+	bool			prune_verify;
+	bool			prune_learned;
+	unsigned long		*prune_map;	/* Writes restoring a reset value */
+	unsigned int		pruned;
+
+	/* Earliest times the controller takes its next command */
+	struct ili9881c_timings	timing;
+	ktime_t			reset_done;
+	ktime_t			sleep_out_done;	/* Display-on */
+	ktime_t			sleep_in_ok;	/* Sleep-in */
+	ktime_t			sleep_in_done;	/* Sleep-out */
+
+	/* Positive then negative curve, written after every init once set */
+	u8			gamma[2 * MOTIVO_GAMMA_TAPS];
+	bool			gamma_set;
+
+	/* CRTC gamma LUT at the tap levels, see ili9881c_crtc_gamma() */
+	struct drm_connector	*connector;	/* Held from get_modes */
+	bool			gamma_crtc;
+	bool			gamma_lut_set;
+	u32			gamma_lut[MOTIVO_GAMMA_TAPS];
 };
 
-#define ILI9881C_SWITCH_PAGE_INSTR(_page)	\
-	{					\
-		.op = ILI9881C_SWITCH_PAGE,	\
-		.arg = {			\
-			.page = (_page),	\
-		},				\
+/* Controller timings: supply settle, reset pulse, reset release and sleep-out */
+#define ILI9881C_POWER_ON_MS	5
+#define ILI9881C_RESET_LOW_MS	20
+#define ILI9881C_RESET_MS	20
+#define ILI9881C_SLEEP_OUT_MS	120
+
+/* Least time between sleep-in and sleep-out either way, not trimmable */
+#define ILI9881C_SLEEP_GUARD_MS	120
+
+/* Arguments that do not fit their byte would silently change the sequence */
+#define ILI9881C_INSTR_BYTE(_x)	((_x) + BUILD_BUG_ON_ZERO((_x) > U8_MAX))
+
+#define ILI9881C_SWITCH_PAGE_INSTR(_page)			\
+	{							\
+		.op = ILI9881C_SWITCH_PAGE,			\
+		.page = ILI9881C_INSTR_BYTE(_page),		\
 	}
 
-#define ILI9881C_COMMAND_INSTR(_cmd, _data)		\
-	{						\
-		.op = ILI9881C_COMMAND,		\
-		.arg = {				\
-			.cmd = {			\
-				.cmd = (_cmd),		\
-				.data = (_data),	\
-			},				\
-		},					\
+#define ILI9881C_COMMAND_INSTR(_cmd, _data)			\
+	{							\
+		.op = ILI9881C_COMMAND,				\
+		.cmd = ILI9881C_INSTR_BYTE(_cmd),		\
+		.data = ILI9881C_INSTR_BYTE(_data),		\
 	}
 
 static const struct ili9881c_instr lhr050h41_init[] = {
@@ -2300,6 +2392,28 @@ static inline struct ili9881c *panel_to_ili9881c(struct drm_panel *panel)
 	return container_of(panel, struct ili9881c, panel);
 }
 
+/* All writes go through here so a trace shows each transfer and its cost */
+static int ili9881c_dcs_write(struct ili9881c *ctx, const u8 *buf, size_t len)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = mipi_dsi_dcs_write_buffer(ctx->dsi, buf, len);
+	if (ret > 0)
+		ret = 0;
+
+	trace_motivo_panel_dcs_write(&ctx->dsi->dev, ctx->page, buf, len,
+				     ktime_to_ns(ktime_sub(ktime_get(), start)),
+				     ret);
+
+	return ret;
+}
+
+static int ili9881c_dcs_cmd(struct ili9881c *ctx, u8 cmd)
+{
+	return ili9881c_dcs_write(ctx, &cmd, 1);
+}
+
 /*
  * The panel seems to accept some private DCS commands that map
  * directly to registers.
@@ -2316,87 +2430,609 @@ static int ili9881c_switch_page(struct ili9881c *ctx, u8 page)
 	u8 buf[4] = { 0xff, 0x98, 0x81, page };
 	int ret;
 
-	ret = mipi_dsi_dcs_write_buffer(ctx->dsi, buf, sizeof(buf));
-	if (ret < 0)
+	if (ctx->page == page) {
+		ctx->page_skips++;
+		return 0;
+	}
+
+	ret = ili9881c_dcs_write(ctx, buf, sizeof(buf));
+	if (ret < 0) {
+		ctx->page = -1;
 		return ret;
+	}
+
+	ctx->page = page;
 
 	return 0;
 }
 
+static void ili9881c_shadow_clear(struct ili9881c *ctx)
+{
+	bitmap_zero(ctx->shadow.valid, ILI9881C_SHADOW_PAGES * 256);
+}
+
+static void ili9881c_shadow_set(struct ili9881c *ctx, u8 page, u8 reg, u8 val)
+{
+	if (page >= ILI9881C_SHADOW_PAGES)
+		return;
+
+	ctx->shadow.val[page][reg] = val;
+	__set_bit(page * 256 + reg, ctx->shadow.valid);
+}
+
+static bool ili9881c_shadow_holds(struct ili9881c *ctx, u8 page, u8 reg,
+				  u8 val)
+{
+	return page < ILI9881C_SHADOW_PAGES &&
+	       test_bit(page * 256 + reg, ctx->shadow.valid) &&
+	       ctx->shadow.val[page][reg] == val;
+}
+
 static int ili9881c_send_cmd_data(struct ili9881c *ctx, u8 cmd, u8 data)
 {
 	u8 buf[2] = { cmd, data };
+
+	return ili9881c_dcs_write(ctx, buf, sizeof(buf));
+}
+
+static int ili9881c_read_reg(struct ili9881c *ctx, u8 reg, u8 *val)
+{
+	int ret;
+
+	ret = mipi_dsi_dcs_read(ctx->dsi, reg, val, 1);
+	if (ret < 0)
+		return ret;
+
+	return ret == 1 ? 0 : -EIO;
+}
+
+/*
+ * Consecutive registers of the vendor pages can be written with a single
+ * long write, the controller auto-incrementing the register address. This
+ * is not documented, so bursts are read back until one has been seen to
+ * land, and we fall back to single writes for good if one did not. Page 0 holds the
+ * standard DCS commands and is never coalesced.
+ */
+static unsigned int ili9881c_burst_len(struct ili9881c *ctx, unsigned int i,
+				       u8 page)
+{
+	const struct ili9881c_instr *init = ctx->desc->init;
+	unsigned int n = 1;
+
+	if (!(ctx->desc->flags & ILI9881_FLAGS_BURST_WRITES) ||
+	    ctx->burst == ILI9881C_BURST_BROKEN || page == 0)
+		return 1;
+
+	while (n < ILI9881C_BURST_MAX && i + n < ctx->desc->init_length &&
+	       init[i + n].op == ILI9881C_COMMAND &&
+	       init[i + n].cmd == init[i].cmd + n &&
+	       !(ctx->prune_learned && test_bit(i + n, ctx->prune_map)))
+		n++;
+
+	return n;
+}
+
+static int ili9881c_send_burst(struct ili9881c *ctx,
+			       const struct ili9881c_instr *instr,
+			       unsigned int n)
+{
+	u8 buf[ILI9881C_BURST_MAX + 1];
+	bool changes = false;
+	unsigned int i;
+	u8 val;
 	int ret;
 
-	ret = mipi_dsi_dcs_write_buffer(ctx->dsi, buf, sizeof(buf));
+	buf[0] = instr[0].cmd;
+	for (i = 0; i < n; i++)
+		buf[i + 1] = instr[i].data;
+
+	/* A burst that leaves its registers as they were passes either way */
+	if (ctx->burst == ILI9881C_BURST_UNTESTED) {
+		for (i = 0; i < n; i++) {
+			if (ili9881c_read_reg(ctx, instr[i].cmd, &val))
+				goto single;
+			changes |= val != instr[i].data;
+		}
+	}
+
+	ret = ili9881c_dcs_write(ctx, buf, n + 1);
 	if (ret < 0)
 		return ret;
 
+	if (ctx->burst == ILI9881C_BURST_OK)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (ili9881c_read_reg(ctx, instr[i].cmd, &val) ||
+		    val != instr[i].data)
+			goto single;
+	}
+
+	if (changes)
+		ctx->burst = ILI9881C_BURST_OK;
+
+	return 0;
+
+single:
+	dev_warn(&ctx->dsi->dev,
+		 "multi-register writes rejected, using single writes\n");
+	ctx->burst = ILI9881C_BURST_BROKEN;
+
+	for (i = 0; i < n; i++) {
+		ret = ili9881c_send_cmd_data(ctx, instr[i].cmd,
+					     instr[i].data);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Wait for a deadline set when a transition was sent, so whatever the host
+ * did in the meantime counts towards the controller timing.
+ */
+static void ili9881c_wait_until(struct ili9881c *ctx, const char *what,
+				ktime_t deadline)
+{
+	s64 us = ktime_us_delta(deadline, ktime_get());
+
+	if (us <= 0)
+		return;
+
+	motivo_trace_delay(&ctx->dsi->dev, what, DIV_ROUND_UP(us, 1000),
+			   DIV_ROUND_UP(us, 1000));
+	fsleep(us);
+}
+
+static void ili9881c_delay(struct ili9881c *ctx, const char *what,
+			   unsigned int ms)
+{
+	motivo_trace_delay(&ctx->dsi->dev, what, ms, ms);
+	msleep(ms);
+}
+
+/* Whether no later instruction writes the same register of the same page */
+static bool ili9881c_last_write(struct ili9881c *ctx, unsigned int i, u8 page)
+{
+	const struct ili9881c_instr *init = ctx->desc->init;
+	unsigned int j;
+	u8 cur = page;
+
+	for (j = i + 1; j < ctx->desc->init_length; j++) {
+		if (init[j].op == ILI9881C_SWITCH_PAGE)
+			cur = init[j].page;
+		else if (cur == page && init[j].cmd == init[i].cmd)
+			return false;
+	}
+
+	return true;
+}
+
+/* Read back the last write to each vendor register, see motivo_prune_check() */
+static void ili9881c_prune_verify(struct ili9881c *ctx)
+{
+	const struct ili9881c_instr *init = ctx->desc->init;
+	unsigned int i, bad = 0;
+	u8 page = 0, val = 0;
+	int ret;
+
+	for (i = 0; i < ctx->desc->init_length; i++) {
+		if (init[i].op == ILI9881C_SWITCH_PAGE) {
+			page = init[i].page;
+			continue;
+		}
+
+		if (page == 0 || !ili9881c_last_write(ctx, i, page))
+			continue;
+
+		ret = ili9881c_switch_page(ctx, page);
+		if (!ret)
+			ret = ili9881c_read_reg(ctx, init[i].cmd, &val);
+		if (!ret)
+			ili9881c_shadow_set(ctx, page, init[i].cmd, val);
+		bad += motivo_prune_check(&ctx->dsi->dev, page, init[i].cmd,
+					  ret, val, init[i].data);
+	}
+
+	ctx->prune = motivo_prune_done(&ctx->dsi->dev, bad, ctx->pruned);
+}
+
+/*
+ * With "motivo,boot-on", a panel the firmware left lit in normal display
+ * mode is taken over as it is on the first prepare instead of being reset
+ * and initialised again. Anything else gets the full sequence.
+ */
+static bool ili9881c_take_over(struct ili9881c *ctx)
+{
+	const u8 lit = MIPI_DCS_POWER_MODE_SLEEP | MIPI_DCS_POWER_MODE_DISPLAY |
+		       MIPI_DCS_POWER_MODE_NORMAL;
+	u8 mode = 0;
+	int ret;
+
+	ctx->handoff = false;
+
+	ret = mipi_dsi_dcs_get_power_mode(ctx->dsi, &mode);
+	if (ret || (mode & lit) != lit) {
+		dev_info(&ctx->dsi->dev, "panel not lit (%d, 0x%02x), full init\n",
+			 ret, mode);
+		return false;
+	}
+
+	ctx->page = -1;
+	ili9881c_shadow_clear(ctx);
+	ctx->sleep_out_done = ktime_get();
+	ctx->sleep_in_ok = ktime_get();
+	dev_info(&ctx->dsi->dev, "taking over the panel lit by the firmware\n");
+
+	return true;
+}
+
+/*
+ * Bring @n registers from @reg on @page to @val, sending only those the
+ * shadow does not show at that value. Runs of changed registers go out as
+ * one long write where the controller takes them, and the page is only
+ * switched when something changed.
+ */
+static int ili9881c_update_regs(struct ili9881c *ctx, u8 page, u8 reg,
+				const u8 *val, unsigned int n)
+{
+	u8 buf[ILI9881C_BURST_MAX + 1];
+	unsigned int i, k, len, max;
+	int ret;
+
+	for (i = 0; i < n; i += len) {
+		len = 1;
+		if (ili9881c_shadow_holds(ctx, page, reg + i, val[i]))
+			continue;
+
+		ret = ili9881c_switch_page(ctx, page);
+		if (ret)
+			return ret;
+
+		max = 1;
+		if (page && ctx->burst == ILI9881C_BURST_OK)
+			max = min_t(unsigned int, n - i, ILI9881C_BURST_MAX);
+		while (len < max &&
+		       !ili9881c_shadow_holds(ctx, page, reg + i + len, val[i + len]))
+			len++;
+
+		buf[0] = reg + i;
+		memcpy(&buf[1], &val[i], len);
+
+		ret = ili9881c_dcs_write(ctx, buf, len + 1);
+		if (ret < 0) {
+			if (page < ILI9881C_SHADOW_PAGES)
+				bitmap_clear(ctx->shadow.valid,
+					     page * 256 + reg + i, len);
+			return ret;
+		}
+
+		for (k = 0; k < len; k++)
+			ili9881c_shadow_set(ctx, page, reg + i + k, val[i + k]);
+	}
+
+	return 0;
+}
+
+/*
+ * RGB888 is the reset value of the pixel format register, so the DCS
+ * set_pixel_format on page 0 is only sent for the RGB666 formats.
+ */
+static int ili9881c_set_pixel_format(struct ili9881c *ctx)
+{
+	const u8 fmt = MIPI_DCS_PIXEL_FMT_18BIT << 4 | MIPI_DCS_PIXEL_FMT_18BIT;
+
+	if (ctx->format == MIPI_DSI_FMT_RGB888)
+		return 0;
+
+	return ili9881c_update_regs(ctx, 0, MIPI_DCS_SET_PIXEL_FORMAT, &fmt, 1);
+}
+
+static int ili9881c_sleep_out(struct ili9881c *ctx)
+{
+	int ret;
+
+	/* A wake from standby can follow the sleep-in closely */
+	ili9881c_wait_until(ctx, "sleep-in", ctx->sleep_in_done);
+
+	ret = ili9881c_dcs_cmd(ctx, MIPI_DCS_EXIT_SLEEP_MODE);
+	if (ret)
+		return ret;
+	ctx->sleep_out_done = ktime_add_ms(ktime_get(), ctx->timing.sleep_out_ms);
+	ctx->sleep_in_ok = ktime_add_ms(ktime_get(), ILI9881C_SLEEP_GUARD_MS);
+
+	if (ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE) {
+		ili9881c_wait_until(ctx, "sleep-out", ctx->sleep_out_done);
+
+		ret = ili9881c_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_ON);
+	}
+
 	return 0;
 }
 
-static int ili9881c_prepare(struct drm_panel *panel)
+static void ili9881c_power_off(struct ili9881c *ctx)
 {
-	struct ili9881c *ctx = panel_to_ili9881c(panel);
+	/* The controller needs the rail until its sleep-in has completed */
+	ili9881c_wait_until(ctx, "sleep-in", ctx->sleep_in_done);
+
+	regulator_disable(ctx->power);
+	gpiod_set_value_cansleep(ctx->reset, 1);
+	ctx->powered = false;
+	ctx->page = -1;
+	ili9881c_shadow_clear(ctx);
+}
+
+static int ili9881c_runtime_suspend(struct device *dev)
+{
+	struct ili9881c *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	if (ctx->standby) {
+		ili9881c_power_off(ctx);
+		ctx->standby = false;
+	}
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
+/* Power comes back in ili9881c_prepare(), with the init */
+static int ili9881c_runtime_resume(struct device *dev)
+{
+	return 0;
+}
+
+/*
+ * The gamma curve of the init table, which is what the panel shows until
+ * one is set through sysfs. Returns false if the table does not write all
+ * of the gamma registers.
+ */
+static bool ili9881c_gamma_defaults(struct ili9881c *ctx, u8 *gamma)
+{
+	DECLARE_BITMAP(seen, 2 * MOTIVO_GAMMA_TAPS);
+	const struct ili9881c_instr *instr;
 	unsigned int i;
+	u8 page = 0;
+	int tap;
+
+	bitmap_zero(seen, 2 * MOTIVO_GAMMA_TAPS);
+	for (i = 0; i < ctx->desc->init_length; i++) {
+		instr = &ctx->desc->init[i];
+		if (instr->op == ILI9881C_SWITCH_PAGE) {
+			page = instr->page;
+			continue;
+		}
+		if (page != MOTIVO_GAMMA_PAGE || instr->op != ILI9881C_COMMAND)
+			continue;
+
+		tap = motivo_gamma_tap(instr->cmd);
+		if (tap < 0)
+			continue;
+
+		gamma[tap] = instr->data;
+		__set_bit(tap, seen);
+	}
+
+	return bitmap_full(seen, 2 * MOTIVO_GAMMA_TAPS);
+}
+
+/*
+ * The sysfs curve or else the init table's, with the CRTC LUT of the last
+ * enable fitted onto it. Only the gamma registers that changed are
+ * written, there is no re-init.
+ */
+static int ili9881c_write_gamma(struct ili9881c *ctx)
+{
+	u8 base[2 * MOTIVO_GAMMA_TAPS], gamma[2 * MOTIVO_GAMMA_TAPS];
 	int ret;
 
+	if (ctx->gamma_set)
+		memcpy(base, ctx->gamma, sizeof(base));
+	else if (!ili9881c_gamma_defaults(ctx, base))
+		return 0;
+
+	if (ctx->gamma_lut_set)
+		motivo_gamma_fit(ctx->gamma_lut, base, gamma);
+	else
+		memcpy(gamma, base, sizeof(gamma));
+
+	ret = ili9881c_update_regs(ctx, MOTIVO_GAMMA_PAGE, MOTIVO_GAMMA_POS,
+				   gamma, MOTIVO_GAMMA_TAPS);
+	if (!ret)
+		ret = ili9881c_update_regs(ctx, MOTIVO_GAMMA_PAGE,
+					   MOTIVO_GAMMA_NEG,
+					   &gamma[MOTIVO_GAMMA_TAPS],
+					   MOTIVO_GAMMA_TAPS);
+
+	return ili9881c_switch_page(ctx, 0) ?: ret;
+}
+
+static int ili9881c_power_on(struct ili9881c *ctx)
+{
+	unsigned int i, k, n, xfers = 0;
+	bool learn = ctx->prune && !ctx->prune_learned;
+	bool prune = ctx->prune && ctx->prune_learned;
+	u8 page = 0, val;
+	int ret;
+
+	if (ctx->standby) {
+		ctx->standby = false;
+		return ili9881c_sleep_out(ctx);
+	}
+
 	/* Power the panel */
 	ret = regulator_enable(ctx->power);
 	if (ret)
 		return ret;
-	msleep(5);
+	ctx->powered = true;
+
+	if (ctx->handoff && ili9881c_take_over(ctx))
+		return ili9881c_set_pixel_format(ctx);
+
+	ili9881c_delay(ctx, "power", ctx->timing.power_on_ms);
 
 	/* And reset it */
 	gpiod_set_value_cansleep(ctx->reset, 1);
-	msleep(20);
+	ili9881c_delay(ctx, "reset low", ctx->timing.reset_low_ms);
 
 	gpiod_set_value_cansleep(ctx->reset, 0);
-	msleep(20);
+	ctx->reset_done = ktime_add_us(ktime_get(), ctx->timing.reset_recovery_us);
+	ili9881c_wait_until(ctx, "reset", ctx->reset_done);
 
-	for (i = 0; i < ctx->desc->init_length; i++) {
+	/* The controller comes out of reset on page 0, at its reset values */
+	ctx->page = 0;
+	ili9881c_shadow_clear(ctx);
+	ctx->page_skips = 0;
+	ctx->pruned = 0;
+
+	for (i = 0; i < ctx->desc->init_length; i += n) {
 		const struct ili9881c_instr *instr = &ctx->desc->init[i];
 
-		if (instr->op == ILI9881C_SWITCH_PAGE)
-			ret = ili9881c_switch_page(ctx, instr->arg.page);
-		else if (instr->op == ILI9881C_COMMAND)
-			ret = ili9881c_send_cmd_data(ctx, instr->arg.cmd.cmd,
-						      instr->arg.cmd.data);
+		n = 1;
+		if (instr->op == ILI9881C_SWITCH_PAGE) {
+			ret = ili9881c_switch_page(ctx, instr->page);
+			page = instr->page;
+		} else if (instr->op == ILI9881C_COMMAND) {
+			if (page != 0 && prune && test_bit(i, ctx->prune_map)) {
+				ili9881c_shadow_set(ctx, page, instr->cmd,
+						    instr->data);
+				ctx->pruned++;
+				continue;
+			}
+
+			if (page != 0 && learn && !ili9881c_read_reg(ctx, instr->cmd, &val) &&
+			    val == instr->data)
+				__set_bit(i, ctx->prune_map);
+
+			n = learn ? 1 : ili9881c_burst_len(ctx, i, page);
+			if (n > 1)
+				ret = ili9881c_send_burst(ctx, instr, n);
+			else
+				ret = ili9881c_send_cmd_data(ctx, instr->cmd,
+							      instr->data);
+		}
 
 		if (ret)
 			return ret;
+
+		for (k = 0; instr->op == ILI9881C_COMMAND && k < n; k++)
+			ili9881c_shadow_set(ctx, page, instr[k].cmd,
+					    instr[k].data);
+		xfers++;
+	}
+
+	if (learn) {
+		ctx->prune_learned = true;
+		dev_info(&ctx->dsi->dev,
+			 "%u init writes restore reset values, skipped from now on\n",
+			 bitmap_weight(ctx->prune_map, ctx->desc->init_length));
+	}
+
+	if (ctx->pruned && ctx->prune_verify)
+		ili9881c_prune_verify(ctx);
+
+	if (ctx->gamma_set || ctx->gamma_lut_set) {
+		ret = ili9881c_write_gamma(ctx);
+		if (ret)
+			return ret;
 	}
 
 	ret = ili9881c_switch_page(ctx, 0);
 	if (ret)
 		return ret;
 
-	ret = mipi_dsi_dcs_set_tear_on(ctx->dsi, MIPI_DSI_DCS_TEAR_MODE_VBLANK);
+	dev_dbg(&ctx->dsi->dev,
+		"init: %u transfers for %zu instructions, %u page switches saved, %u writes pruned\n",
+		xfers - ctx->page_skips, ctx->desc->init_length, ctx->page_skips,
+		ctx->pruned);
+
+	ret = ili9881c_set_pixel_format(ctx);
 	if (ret)
 		return ret;
 
-	ret = mipi_dsi_dcs_exit_sleep_mode(ctx->dsi);
+	ret = ili9881c_send_cmd_data(ctx, MIPI_DCS_SET_TEAR_ON,
+				     MIPI_DSI_DCS_TEAR_MODE_VBLANK);
 	if (ret)
 		return ret;
 
-	if (ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE) {
-		msleep(120);
+	return ili9881c_sleep_out(ctx);
+}
 
-		ret = mipi_dsi_dcs_set_display_on(ctx->dsi);
+static int ili9881c_prepare(struct drm_panel *panel)
+{
+	struct ili9881c *ctx = panel_to_ili9881c(panel);
+	int ret;
+
+	trace_motivo_panel_begin(panel->dev, "prepare");
+
+	/* Keeps a panel in standby from autosuspending under us */
+	if (!ctx->active) {
+		ret = pm_runtime_resume_and_get(panel->dev);
+		if (ret < 0)
+			goto out;
+		ctx->active = true;
 	}
 
-	return 0;
+	mutex_lock(&ctx->lock);
+	ret = ili9881c_power_on(ctx);
+	/* DRM does not unprepare a panel that failed to prepare */
+	if (ret && ctx->powered)
+		ili9881c_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+
+	if (ret) {
+		ctx->active = false;
+		pm_runtime_put_autosuspend(panel->dev);
+	}
+
+out:
+	trace_motivo_panel_end(panel->dev, "prepare", ret);
+
+	return ret;
+}
+
+/*
+ * With "motivo,gamma-from-crtc" the CRTC gamma LUT is fitted to the panel
+ * taps, so the panel does the correction at no cost per frame. It is read
+ * in the commit that enables the panel: a LUT changed without a modeset
+ * is not seen. Dropping the LUT puts the plain curve back.
+ */
+static int ili9881c_crtc_gamma(struct ili9881c *ctx)
+{
+	bool had = ctx->gamma_lut_set;
+
+	if (!ctx->gamma_crtc || !ctx->powered)
+		return 0;
+
+	ctx->gamma_lut_set = motivo_gamma_sample(ctx->connector, ctx->gamma_lut);
+	if (!ctx->gamma_lut_set && !had)
+		return 0;
+
+	return ili9881c_write_gamma(ctx);
 }
 
 static int ili9881c_enable(struct drm_panel *panel)
 {
 	struct ili9881c *ctx = panel_to_ili9881c(panel);
+	int ret = 0;
+
+	trace_motivo_panel_begin(panel->dev, "enable");
 
-	if (!(ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE)) {
-		msleep(120);
+	mutex_lock(&ctx->lock);
+	ret = ili9881c_crtc_gamma(ctx);
+	if (ret)
+		dev_err(&ctx->dsi->dev, "failed to write the gamma: %d\n", ret);
 
-		mipi_dsi_dcs_set_display_on(ctx->dsi);
+	if (ctx->powered && !(ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE)) {
+		/* Usually long over by the time vc4 has the CRTC running */
+		ili9881c_wait_until(ctx, "sleep-out", ctx->sleep_out_done);
+
+		ret = ili9881c_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_ON);
 	}
+	mutex_unlock(&ctx->lock);
+
+	trace_motivo_panel_end(panel->dev, "enable", ret);
 
 	return 0;
 }
@@ -2404,9 +3040,16 @@ static int ili9881c_enable(struct drm_panel *panel)
 static int ili9881c_disable(struct drm_panel *panel)
 {
 	struct ili9881c *ctx = panel_to_ili9881c(panel);
+	int ret = 0;
 
-	if (!(ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE))
-		mipi_dsi_dcs_set_display_off(ctx->dsi);
+	trace_motivo_panel_begin(panel->dev, "disable");
+
+	mutex_lock(&ctx->lock);
+	if (ctx->powered && !(ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE))
+		ret = ili9881c_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_OFF);
+	mutex_unlock(&ctx->lock);
+
+	trace_motivo_panel_end(panel->dev, "disable", ret);
 
 	return 0;
 }
@@ -2414,16 +3057,49 @@ static int ili9881c_disable(struct drm_panel *panel)
 static int ili9881c_unprepare(struct drm_panel *panel)
 {
 	struct ili9881c *ctx = panel_to_ili9881c(panel);
+	int ret;
+
+	trace_motivo_panel_begin(panel->dev, "unprepare");
+
+	mutex_lock(&ctx->lock);
+	/* The power-up failed */
+	if (!ctx->powered)
+		goto out;
 
 	if (!(ctx->desc->flags & ILI9881_FLAGS_NO_SHUTDOWN_CMDS)) {
 		if (ctx->desc->flags & ILI9881_FLAGS_PANEL_ON_IN_PREPARE)
-			mipi_dsi_dcs_set_display_off(ctx->dsi);
+			ili9881c_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_OFF);
+
+		/* Sleep-in is not allowed within 120 ms of sleep-out either */
+		ili9881c_wait_until(ctx, "sleep-out", ctx->sleep_in_ok);
+		ret = ili9881c_dcs_cmd(ctx, MIPI_DCS_ENTER_SLEEP_MODE);
+		ctx->sleep_in_done = ktime_add_ms(ktime_get(),
+						  ILI9881C_SLEEP_GUARD_MS);
+
+		/*
+		 * Switching between the low refresh modes is a full modeset
+		 * on vc4, and a blank is often short. Keep the asleep panel
+		 * initialised until runtime PM autosuspends it, so a prepare
+		 * in the meantime does not reset it.
+		 */
+		if (!ret && ctx->standby_ok && !ctx->suspended) {
+			ctx->standby = true;
+			goto out;
+		}
+	}
+
+	ili9881c_power_off(ctx);
 
-		mipi_dsi_dcs_enter_sleep_mode(ctx->dsi);
+out:
+	mutex_unlock(&ctx->lock);
+
+	if (ctx->active) {
+		ctx->active = false;
+		pm_runtime_mark_last_busy(panel->dev);
+		pm_runtime_put_autosuspend(panel->dev);
 	}
 
-	regulator_disable(ctx->power);
-	gpiod_set_value_cansleep(ctx->reset, 1);
+	trace_motivo_panel_end(panel->dev, "unprepare", 0);
 
 	return 0;
 }
@@ -2633,7 +3309,9 @@ static int ili9881c_get_modes(struct drm_panel *panel,
 			      struct drm_connector *connector)
 {
 	struct ili9881c *ctx = panel_to_ili9881c(panel);
+	struct drm_connector *old;
 	struct drm_display_mode *mode;
+	int count = 1;
 
 	mode = drm_mode_duplicate(connector->dev, ctx->desc->mode);
 	if (!mode) {
@@ -2651,6 +3329,23 @@ static int ili9881c_get_modes(struct drm_panel *panel,
 
 	connector->display_info.width_mm = mode->width_mm;
 	connector->display_info.height_mm = mode->height_mm;
+	/* Only the DT can narrow the link, the upstream panels keep theirs */
+	if (ctx->format != MIPI_DSI_FMT_RGB888)
+		connector->display_info.bpc =
+			mipi_dsi_pixel_format_to_bpp(ctx->format) / 3;
+
+	if (ctx->desc->flags & ILI9881_FLAGS_LOW_REFRESH)
+		count += motivo_add_low_refresh(connector, ctx->desc->mode,
+						ctx->format, ctx->desc->lanes);
+
+	/* Held until the next get_modes or ili9881c_dsi_remove() */
+	drm_connector_get(connector);
+	mutex_lock(&ctx->lock);
+	old = ctx->connector;
+	ctx->connector = connector;
+	mutex_unlock(&ctx->lock);
+	if (old)
+		drm_connector_put(old);
 
 	/*
 	 * TODO: Remove once all drm drivers call
@@ -2658,7 +3353,7 @@ static int ili9881c_get_modes(struct drm_panel *panel,
 	 */
 	drm_connector_set_panel_orientation(connector, ctx->orientation);
 
-	return 1;
+	return count;
 }
 
 static enum drm_panel_orientation ili9881c_get_orientation(struct drm_panel *panel)
@@ -2668,6 +3363,70 @@ static enum drm_panel_orientation ili9881c_get_orientation(struct drm_panel *pan
 	return ctx->orientation;
 }
 
+/*
+ * The panel curve in the format of motivo_gamma_parse(), and the one the
+ * CRTC LUT is fitted onto with "motivo,gamma-from-crtc".
+ */
+static ssize_t gamma_show(struct device *dev, struct device_attribute *attr,
+			  char *buf)
+{
+	struct ili9881c *ctx = dev_get_drvdata(dev);
+	u8 gamma[2 * MOTIVO_GAMMA_TAPS];
+	bool ok = true;
+
+	mutex_lock(&ctx->lock);
+	if (ctx->gamma_set)
+		memcpy(gamma, ctx->gamma, sizeof(gamma));
+	else
+		ok = ili9881c_gamma_defaults(ctx, gamma);
+	mutex_unlock(&ctx->lock);
+
+	return ok ? motivo_gamma_show(buf, gamma) : -ENODATA;
+}
+
+static ssize_t gamma_store(struct device *dev, struct device_attribute *attr,
+			   const char *buf, size_t count)
+{
+	struct ili9881c *ctx = dev_get_drvdata(dev);
+	u8 gamma[2 * MOTIVO_GAMMA_TAPS];
+	int set, ret = 0;
+
+	set = motivo_gamma_parse(buf, gamma);
+	if (set < 0)
+		return set;
+
+	mutex_lock(&ctx->lock);
+
+	/* Also checks that the init table sets the gamma at all */
+	if (!ili9881c_gamma_defaults(ctx, ctx->gamma)) {
+		ret = -ENODATA;
+		goto out;
+	}
+
+	if (set)
+		memcpy(ctx->gamma, gamma, sizeof(gamma));
+	ctx->gamma_set = set;
+
+	/* A panel that is off gets the curve with its next init */
+	if (ctx->powered)
+		ret = ili9881c_write_gamma(ctx);
+
+out:
+	mutex_unlock(&ctx->lock);
+
+	return ret ?: count;
+}
+static DEVICE_ATTR_RW(gamma);
+
+static struct attribute *ili9881c_attrs[] = {
+	&dev_attr_gamma.attr,
+	NULL
+};
+
+static const struct attribute_group ili9881c_attr_group = {
+	.attrs = ili9881c_attrs,
+};
+
 static const struct drm_panel_funcs ili9881c_funcs = {
 	.prepare	= ili9881c_prepare,
 	.unprepare	= ili9881c_unprepare,
@@ -2677,9 +3436,43 @@ static const struct drm_panel_funcs ili9881c_funcs = {
 	.get_orientation = ili9881c_get_orientation,
 };
 
+/*
+ * The defaults suit the slowest panel revision seen so far. The overlay
+ * can trim them per product, down to what the controller allows: a reset
+ * pulse of 1 ms, the property's unit (the datasheet asks for 10 us), and
+ * 5 ms before the first command after reset or sleep-out. The sleep-out
+ * time only gates display-on, sleep-in keeps the full ILI9881C_SLEEP_GUARD_MS.
+ */
+static void ili9881c_parse_timings(struct ili9881c *ctx)
+{
+	struct device *dev = &ctx->dsi->dev;
+	struct ili9881c_timings *t = &ctx->timing;
+
+	t->power_on_ms = motivo_read_timing(dev, "motivo,power-on-ms",
+					    ILI9881C_POWER_ON_MS, 1,
+					    MOTIVO_TIMING_MAX_MS);
+	t->reset_low_ms = motivo_read_timing(dev, "motivo,reset-low-ms",
+					     ILI9881C_RESET_LOW_MS, 1,
+					     MOTIVO_TIMING_MAX_MS);
+	t->reset_recovery_us = motivo_read_timing(dev, "motivo,reset-recovery-us",
+						  ILI9881C_RESET_MS * 1000,
+						  5000, MOTIVO_TIMING_MAX_MS * 1000);
+	t->sleep_out_ms = motivo_read_timing(dev, "motivo,sleep-out-ms",
+					     ILI9881C_SLEEP_OUT_MS, 5,
+					     MOTIVO_TIMING_MAX_MS);
+}
+
+static const struct ili9881c_desc *ili9881c_match_desc(struct mipi_dsi_device *dsi)
+{
+	KUNIT_STATIC_STUB_REDIRECT(ili9881c_match_desc, dsi);
+
+	return of_device_get_match_data(&dsi->dev);
+}
+
 static int ili9881c_dsi_probe(struct mipi_dsi_device *dsi)
 {
 	struct ili9881c *ctx;
+	u32 standby_ms;
 	int ret;
 
 	ctx = devm_kzalloc(&dsi->dev, sizeof(*ctx), GFP_KERNEL);
@@ -2687,7 +3480,8 @@ static int ili9881c_dsi_probe(struct mipi_dsi_device *dsi)
 		return -ENOMEM;
 	mipi_dsi_set_drvdata(dsi, ctx);
 	ctx->dsi = dsi;
-	ctx->desc = of_device_get_match_data(&dsi->dev);
+	ctx->page = -1;
+	ctx->desc = ili9881c_match_desc(dsi);
 
 	ctx->panel.prepare_prev_first = true;
 	drm_panel_init(&ctx->panel, &dsi->dev, &ili9881c_funcs,
@@ -2714,10 +3508,49 @@ static int ili9881c_dsi_probe(struct mipi_dsi_device *dsi)
 	if (ret)
 		return ret;
 
+	ctx->format = MIPI_DSI_FMT_RGB888;
+	ret = motivo_parse_format(&dsi->dev, ctx->desc->mode, ctx->desc->lanes,
+				  &ctx->format);
+	if (ret)
+		return ret;
+
+	ctx->handoff = of_property_read_bool(dsi->dev.of_node, "motivo,boot-on");
+	ctx->gamma_crtc = of_property_read_bool(dsi->dev.of_node,
+						"motivo,gamma-from-crtc");
+	ili9881c_parse_timings(ctx);
+	mutex_init(&ctx->lock);
+
+	/* Standby only when the DT asks for one */
+	standby_ms = 0;
+	ctx->standby_ok = !of_property_read_u32(dsi->dev.of_node,
+						"motivo,standby-ms",
+						&standby_ms);
+
+	pm_runtime_set_autosuspend_delay(&dsi->dev, standby_ms);
+	pm_runtime_use_autosuspend(&dsi->dev);
+	ret = devm_pm_runtime_enable(&dsi->dev);
+	if (ret)
+		return ret;
+
+	if (of_property_read_bool(dsi->dev.of_node, "motivo,prune-defaults")) {
+		ctx->prune_map = devm_bitmap_zalloc(&dsi->dev, ctx->desc->init_length,
+						    GFP_KERNEL);
+		if (!ctx->prune_map)
+			return -ENOMEM;
+
+		ctx->prune = true;
+		ctx->prune_verify = of_property_read_bool(dsi->dev.of_node,
+							  "motivo,prune-verify");
+	}
+
+	ret = devm_device_add_group(&dsi->dev, &ili9881c_attr_group);
+	if (ret)
+		return ret;
+
 	drm_panel_add(&ctx->panel);
 
 	dsi->mode_flags = ctx->desc->mode_flags;
-	dsi->format = MIPI_DSI_FMT_RGB888;
+	dsi->format = ctx->format;
 	dsi->lanes = ctx->desc->lanes;
 
 	ret = mipi_dsi_attach(dsi);
@@ -2734,8 +3567,44 @@ static void ili9881c_dsi_remove(struct mipi_dsi_device *dsi)
 	mipi_dsi_detach(dsi);
 	drm_panel_remove(&ctx->panel);
 
-	gpiod_set_value_cansleep(ctx->reset, 1);
-	regulator_disable(ctx->power);
+	/* Also drops the supply of a panel left in standby */
+	mutex_lock(&ctx->lock);
+	ctx->standby = false;
+	if (ctx->powered)
+		ili9881c_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+
+	if (ctx->connector)
+		drm_connector_put(ctx->connector);
+	ctx->connector = NULL;
+}
+
+/*
+ * Reboot and poweroff: display-off and sleep-in if the panel takes them,
+ * then the rail, whether or not DRM disabled the panel first. The rail
+ * goes once the sleep-in has completed, as after ili9881c_unprepare().
+ */
+static void ili9881c_dsi_shutdown(struct mipi_dsi_device *dsi)
+{
+	struct ili9881c *ctx = mipi_dsi_get_drvdata(dsi);
+
+	trace_motivo_panel_begin(&dsi->dev, "shutdown");
+
+	mutex_lock(&ctx->lock);
+	ctx->standby = false;
+	if (ctx->powered) {
+		if (!(ctx->desc->flags & ILI9881_FLAGS_NO_SHUTDOWN_CMDS)) {
+			ili9881c_dcs_cmd(ctx, MIPI_DCS_SET_DISPLAY_OFF);
+			ili9881c_wait_until(ctx, "sleep-out", ctx->sleep_in_ok);
+			ili9881c_dcs_cmd(ctx, MIPI_DCS_ENTER_SLEEP_MODE);
+			ctx->sleep_in_done = ktime_add_ms(ktime_get(),
+							  ILI9881C_SLEEP_GUARD_MS);
+		}
+		ili9881c_power_off(ctx);
+	}
+	mutex_unlock(&ctx->lock);
+
+	trace_motivo_panel_end(&dsi->dev, "shutdown", 0);
 }
 
 static const struct ili9881c_desc lhr050h41_desc = {
@@ -2760,6 +3629,7 @@ static const struct ili9881c_desc nwe080_desc = {
 	.mode = &nwe080_default_mode,
 	.mode_flags = MIPI_DSI_MODE_VIDEO_SYNC_PULSE | MIPI_DSI_MODE_VIDEO,
 	.lanes = 4,
+	.flags = ILI9881_FLAGS_BURST_WRITES | ILI9881_FLAGS_LOW_REFRESH,
 };
 
 static const struct ili9881c_desc tl050hdv35_desc = {
@@ -2809,6 +3679,7 @@ static const struct ili9881c_desc z80033_ph31_desc = {
 	.mode = &z80033_ph31_default_mode,
 	.mode_flags = MIPI_DSI_MODE_VIDEO_SYNC_PULSE | MIPI_DSI_MODE_VIDEO,
 	.lanes = 4,
+	.flags = ILI9881_FLAGS_BURST_WRITES | ILI9881_FLAGS_LOW_REFRESH,
 };
 
 static const struct ili9881c_desc mtf080wx26a_v1_desc = {
@@ -2817,6 +3688,7 @@ static const struct ili9881c_desc mtf080wx26a_v1_desc = {
 	.mode = &mtf080wx26a_v1_default_mode,
 	.mode_flags = MIPI_DSI_MODE_VIDEO_SYNC_PULSE | MIPI_DSI_MODE_VIDEO,
 	.lanes = 4,
+	.flags = ILI9881_FLAGS_BURST_WRITES | ILI9881_FLAGS_LOW_REFRESH,
 };
 
 static const struct ili9881c_desc rv080wxm_desc = {
@@ -2825,6 +3697,7 @@ static const struct ili9881c_desc rv080wxm_desc = {
 	.mode = &rv080wxm_default_mode,
 	.mode_flags = MIPI_DSI_MODE_VIDEO_SYNC_PULSE | MIPI_DSI_MODE_VIDEO,
 	.lanes = 4,
+	.flags = ILI9881_FLAGS_BURST_WRITES | ILI9881_FLAGS_LOW_REFRESH,
 };
 
 static const struct ili9881c_desc mt1280800_desc = {
@@ -2833,6 +3706,7 @@ static const struct ili9881c_desc mt1280800_desc = {
 	.mode = &mt1280800_default_mode,
 	.mode_flags = MIPI_DSI_MODE_VIDEO_SYNC_PULSE | MIPI_DSI_MODE_VIDEO,
 	.lanes = 4,
+	.flags = ILI9881_FLAGS_LOW_REFRESH,
 };
 
 static const struct of_device_id ili9881c_of_match[] = {
@@ -2852,12 +3726,53 @@ static const struct of_device_id ili9881c_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, ili9881c_of_match);
 
+/*
+ * The panel device comes after the vc4 DRM device and suspends first,
+ * while still prepared, so the unprepare of DRM's suspend commit runs
+ * after this. It must power the panel off then rather than leave it in a
+ * standby whose timer would not run, and a standby already parked is
+ * dropped here.
+ */
+static int ili9881c_suspend(struct device *dev)
+{
+	struct ili9881c *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	ctx->suspended = true;
+	if (ctx->standby) {
+		ili9881c_power_off(ctx);
+		ctx->standby = false;
+	}
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
+/* Power comes back with the prepare of DRM's resume commit */
+static int ili9881c_resume(struct device *dev)
+{
+	struct ili9881c *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	ctx->suspended = false;
+	mutex_unlock(&ctx->lock);
+
+	return 0;
+}
+
+static const struct dev_pm_ops ili9881c_pm_ops = {
+	SYSTEM_SLEEP_PM_OPS(ili9881c_suspend, ili9881c_resume)
+	RUNTIME_PM_OPS(ili9881c_runtime_suspend, ili9881c_runtime_resume, NULL)
+};
+
 static struct mipi_dsi_driver ili9881c_dsi_driver = {
 	.probe		= ili9881c_dsi_probe,
 	.remove		= ili9881c_dsi_remove,
+	.shutdown	= ili9881c_dsi_shutdown,
 	.driver = {
 		.name		= "ili9881c-dsi",
 		.of_match_table	= ili9881c_of_match,
+		.pm		= pm_ptr(&ili9881c_pm_ops),
 	},
 };
 module_mipi_dsi_driver(ili9881c_dsi_driver);
@@ -2865,3 +3780,7 @@ module_mipi_dsi_driver(ili9881c_dsi_driver);
 MODULE_AUTHOR("Maxime Ripard <maxime.ripard@free-electrons.com>");
 MODULE_DESCRIPTION("Ilitek ILI9881C Controller Driver");
 MODULE_LICENSE("GPL v2");
+
+#if IS_ENABLED(CONFIG_DRM_PANEL_MOTIVO_KUNIT_TEST)
+#include "panel-ilitek-ili9881c-test.c"
+#endif
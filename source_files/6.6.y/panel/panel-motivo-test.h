@@ -0,0 +1,393 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Fake MIPI DSI host and fixture for the KUnit suites of the Motivo panel
+ * drivers.
+ *
+ * The host stands in for vc4 and an ILI9881C at once: it counts every
+ * packet, tracks the command page and keeps a register file per page, so
+ * read-backs see what was written, and answers the DCS power mode from
+ * the sleep and display commands it received. A reset through the GPIO
+ * is not seen, a suite calls motivo_test_hw_reset() where one is due.
+ * Writes can be delayed and failed on demand, long writes in HS mode
+ * refused, and the auto-increment of long writes turned off. The delays
+ * a driver serves are summed through a stub of motivo_trace_delay().
+ *
+ * Each test case runs once per compatible of the driver. The fixture binds
+ * the driver with its real probe; without a DT the suite redirects the
+ * driver's match data lookup to motivo_test_match_data().
+ */
+#ifndef _PANEL_MOTIVO_TEST_H
+#define _PANEL_MOTIVO_TEST_H
+
+#include <kunit/static_stub.h>
+#include <kunit/test.h>
+#include <kunit/test-bug.h>
+
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/mod_devicetable.h>
+#include <linux/pm_runtime.h>
+#include <linux/string.h>
+
+#include <drm/drm_mipi_dsi.h>
+#include <drm/drm_panel.h>
+
+#include <video/mipi_display.h>
+
+#include "panel-motivo.h"
+
+#define MOTIVO_TEST_PAGES	8
+
+/* Power mode of a controller out of reset, and the bits sleep-out sets */
+#define MOTIVO_TEST_MODE_RESET	MIPI_DCS_POWER_MODE_NORMAL
+#define MOTIVO_TEST_MODE_AWAKE	(MIPI_DCS_POWER_MODE_SLEEP | BIT(7))
+
+struct motivo_test_host {
+	struct mipi_dsi_host host;
+	struct mipi_dsi_device *dsi;
+
+	/* Controller model */
+	u8 page;
+	u8 mode;
+	u8 regs[MOTIVO_TEST_PAGES][256];
+
+	/* Fail @fail_count writes from the @fail_at'th one on, with @fail_err */
+	unsigned int fail_at;
+	unsigned int fail_count;
+	int fail_err;
+	unsigned int latency_us;	/* Added to every write */
+	bool no_burst;			/* Long writes only set their first register */
+	bool fail_hs_long;		/* Fail the long writes sent in HS mode */
+
+	unsigned int attached;
+	unsigned int writes;
+	unsigned int reads;
+	unsigned int bytes;
+	unsigned int page_switches;
+	unsigned int failures;
+	unsigned int delays;
+	unsigned int delay_ms;		/* Sum of the delays served */
+};
+
+static inline struct motivo_test_host *
+to_motivo_test_host(struct mipi_dsi_host *host)
+{
+	return container_of(host, struct motivo_test_host, host);
+}
+
+static int motivo_test_attach(struct mipi_dsi_host *host,
+			      struct mipi_dsi_device *dsi)
+{
+	to_motivo_test_host(host)->attached++;
+
+	return 0;
+}
+
+static int motivo_test_detach(struct mipi_dsi_host *host,
+			      struct mipi_dsi_device *dsi)
+{
+	to_motivo_test_host(host)->attached--;
+
+	return 0;
+}
+
+static void motivo_test_dcs(struct motivo_test_host *h, const u8 *tx,
+			    size_t len)
+{
+	size_t i;
+
+	if (len == 4 && tx[0] == 0xff && tx[1] == 0x98 && tx[2] == 0x81) {
+		h->page = tx[3];
+		h->page_switches++;
+		return;
+	}
+
+	if (h->page == 0) {
+		switch (tx[0]) {
+		case MIPI_DCS_SOFT_RESET:
+			h->mode = MOTIVO_TEST_MODE_RESET;
+			return;
+		case MIPI_DCS_EXIT_SLEEP_MODE:
+			h->mode |= MOTIVO_TEST_MODE_AWAKE;
+			return;
+		case MIPI_DCS_ENTER_SLEEP_MODE:
+			h->mode &= ~MOTIVO_TEST_MODE_AWAKE;
+			return;
+		case MIPI_DCS_SET_DISPLAY_ON:
+			h->mode |= MIPI_DCS_POWER_MODE_DISPLAY;
+			return;
+		case MIPI_DCS_SET_DISPLAY_OFF:
+			h->mode &= ~MIPI_DCS_POWER_MODE_DISPLAY;
+			return;
+		}
+	}
+
+	/* Long writes auto-increment the register address, unless @no_burst */
+	if (h->page < MOTIVO_TEST_PAGES)
+		for (i = 1; i < len && tx[0] + i - 1 < 256; i++) {
+			h->regs[h->page][tx[0] + i - 1] = tx[i];
+			if (h->no_burst)
+				break;
+		}
+}
+
+static ssize_t motivo_test_transfer(struct mipi_dsi_host *host,
+				    const struct mipi_dsi_msg *msg)
+{
+	struct motivo_test_host *h = to_motivo_test_host(host);
+	const u8 *tx = msg->tx_buf;
+	u8 *rx = msg->rx_buf;
+	size_t i;
+
+	if (msg->rx_len) {
+		h->reads++;
+		for (i = 0; i < msg->rx_len; i++) {
+			if (h->page == 0 && tx[0] == MIPI_DCS_GET_POWER_MODE)
+				rx[i] = h->mode;
+			else if (h->page < MOTIVO_TEST_PAGES && tx[0] + i < 256)
+				rx[i] = h->regs[h->page][tx[0] + i];
+			else
+				rx[i] = 0;
+		}
+
+		return msg->rx_len;
+	}
+
+	h->writes++;
+	h->bytes += msg->tx_len;
+
+	if (h->latency_us)
+		fsleep(h->latency_us);
+
+	if (h->fail_at && h->writes >= h->fail_at &&
+	    h->writes < h->fail_at + h->fail_count) {
+		h->failures++;
+		return h->fail_err;
+	}
+
+	if (h->fail_hs_long && msg->type == MIPI_DSI_DCS_LONG_WRITE &&
+	    !(msg->flags & MIPI_DSI_MSG_USE_LPM)) {
+		h->failures++;
+		return -EIO;
+	}
+
+	switch (msg->type) {
+	case MIPI_DSI_DCS_SHORT_WRITE:
+	case MIPI_DSI_DCS_SHORT_WRITE_PARAM:
+	case MIPI_DSI_DCS_LONG_WRITE:
+		motivo_test_dcs(h, tx, msg->tx_len);
+		break;
+	}
+
+	return msg->tx_len;
+}
+
+static const struct mipi_dsi_host_ops motivo_test_host_ops = {
+	.attach = motivo_test_attach,
+	.detach = motivo_test_detach,
+	.transfer = motivo_test_transfer,
+};
+
+/* Stands in for motivo_trace_delay(), the delay itself is still served */
+static void motivo_test_delay(struct device *dev, const char *what,
+			      unsigned int ms, unsigned int max_ms)
+{
+	struct motivo_test_host *h = kunit_get_current_test()->priv;
+
+	if (!h || dev != &h->dsi->dev)
+		return;
+
+	h->delays++;
+	h->delay_ms += ms;
+}
+
+/* Register a DSI device named @name on a fake host, still unbound */
+static struct motivo_test_host *motivo_test_host_init(struct kunit *test,
+						      const char *name)
+{
+	struct mipi_dsi_device_info info = { .channel = 0 };
+	struct motivo_test_host *h;
+	struct device *root;
+
+	h = kunit_kzalloc(test, sizeof(*h), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, h);
+
+	root = root_device_register(name);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(root));
+
+	strscpy(info.type, name, sizeof(info.type));
+	h->host.dev = root;
+	h->host.ops = &motivo_test_host_ops;
+	h->mode = MOTIVO_TEST_MODE_RESET;
+
+	/* The controller ID on page 1 */
+	h->regs[1][0] = 0x98;
+	h->regs[1][1] = 0x81;
+	h->regs[1][2] = 0x0c;
+
+	h->dsi = mipi_dsi_device_register_full(&h->host, &info);
+	if (IS_ERR(h->dsi)) {
+		root_device_unregister(root);
+		KUNIT_FAIL(test, "Cannot register the DSI device: %ld",
+			   PTR_ERR(h->dsi));
+		return NULL;
+	}
+
+	return h;
+}
+
+static void motivo_test_host_exit(struct motivo_test_host *h)
+{
+	struct device *root = h->host.dev;
+
+	mipi_dsi_device_unregister(h->dsi);
+	root_device_unregister(root);
+}
+
+/* What the controller would see of a reset through the GPIO */
+static void motivo_test_hw_reset(struct motivo_test_host *h)
+{
+	h->page = 0;
+	h->mode = MOTIVO_TEST_MODE_RESET;
+}
+
+static void motivo_test_reset_counts(struct motivo_test_host *h)
+{
+	h->writes = 0;
+	h->reads = 0;
+	h->bytes = 0;
+	h->page_switches = 0;
+	h->failures = 0;
+	h->delays = 0;
+	h->delay_ms = 0;
+}
+
+static void motivo_test_report(struct kunit *test, struct motivo_test_host *h,
+			       const char *what, s64 blocked_us)
+{
+	kunit_info(test,
+		   "%s: %u writes (%u bytes), %u reads, %u page switches, %u delays for %u ms, blocked %lld us\n",
+		   what, h->writes, h->bytes, h->reads, h->page_switches,
+		   h->delays, h->delay_ms, blocked_us);
+}
+
+/* Parameter generator over the compatibles of @table */
+static const void *motivo_test_next_id(const void *prev, char *desc,
+				       const struct of_device_id *table)
+{
+	const struct of_device_id *id = prev;
+
+	id = id ? id + 1 : table;
+	if (!id->compatible[0])
+		return NULL;
+
+	strscpy(desc, id->compatible, KUNIT_PARAM_DESC_SIZE);
+
+	return id;
+}
+
+/* What of_device_get_match_data() gives for the compatible under test */
+static const void *motivo_test_match_data(void)
+{
+	const struct of_device_id *id = kunit_get_current_test()->param_value;
+
+	return id->data;
+}
+
+/*
+ * Bind @probe to the device of @h as the driver core would. Runtime PM
+ * gets a 500 ms autosuspend delay, as with motivo,standby-ms, for the
+ * cases that turn the standby on.
+ */
+static void motivo_test_probe(struct kunit *test, struct motivo_test_host *h,
+			      int (*probe)(struct mipi_dsi_device *dsi))
+{
+	int ret;
+
+	/* Needs CONFIG_REGULATOR=n, or a dummy regulator for a device without DT */
+	ret = probe(h->dsi);
+	if (ret)
+		mipi_dsi_set_drvdata(h->dsi, NULL);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	pm_runtime_set_autosuspend_delay(&h->dsi->dev, 500);
+}
+
+/* Unbind @remove from the device of @h if it is bound, and drop the host */
+static void motivo_test_remove(struct motivo_test_host *h,
+			       void (*remove)(struct mipi_dsi_device *dsi))
+{
+	if (mipi_dsi_get_drvdata(h->dsi))
+		remove(h->dsi);
+	motivo_test_host_exit(h);
+}
+
+static int motivo_test_init(struct kunit *test, const char *name,
+			    int (*probe)(struct mipi_dsi_device *dsi))
+{
+	struct motivo_test_host *h;
+
+	h = motivo_test_host_init(test, name);
+	if (!h)
+		return -ENODEV;
+	test->priv = h;
+
+	kunit_activate_static_stub(test, motivo_trace_delay, motivo_test_delay);
+
+	motivo_test_probe(test, h, probe);
+
+	return 0;
+}
+
+static void motivo_test_exit(struct kunit *test,
+			     void (*remove)(struct mipi_dsi_device *dsi))
+{
+	if (test->priv)
+		motivo_test_remove(test->priv, remove);
+}
+
+/* Prepare and enable @panel through DRM, as a modeset to it does */
+static int motivo_test_on(struct kunit *test, struct drm_panel *panel,
+			  const char *what)
+{
+	struct motivo_test_host *h = test->priv;
+	ktime_t start;
+	int ret;
+
+	motivo_test_reset_counts(h);
+	start = ktime_get();
+	ret = drm_panel_prepare(panel);
+	if (!ret)
+		ret = drm_panel_enable(panel);
+	motivo_test_report(test, h, what, ktime_us_delta(ktime_get(), start));
+
+	return ret;
+}
+
+static void motivo_test_off(struct kunit *test, struct drm_panel *panel,
+			    const char *what)
+{
+	struct motivo_test_host *h = test->priv;
+	ktime_t start;
+
+	motivo_test_reset_counts(h);
+	start = ktime_get();
+	KUNIT_EXPECT_EQ(test, drm_panel_disable(panel), 0);
+	KUNIT_EXPECT_EQ(test, drm_panel_unprepare(panel), 0);
+	motivo_test_report(test, h, what, ktime_us_delta(ktime_get(), start));
+}
+
+/*
+ * The cases of every suite. A suite defines <prefix>_test_power_cycle,
+ * _standby, _suspend, _timings and _shutdown on the fixture above, and
+ * <prefix>_test_gen_params.
+ */
+#define MOTIVO_TEST_CASES(prefix)						\
+	KUNIT_CASE_PARAM(prefix##_test_power_cycle, prefix##_test_gen_params),	\
+	KUNIT_CASE_PARAM(prefix##_test_standby, prefix##_test_gen_params),	\
+	KUNIT_CASE_PARAM(prefix##_test_suspend, prefix##_test_gen_params),	\
+	KUNIT_CASE_PARAM(prefix##_test_timings, prefix##_test_gen_params),	\
+	KUNIT_CASE_PARAM(prefix##_test_shutdown, prefix##_test_gen_params)
+
+#endif /* _PANEL_MOTIVO_TEST_H */
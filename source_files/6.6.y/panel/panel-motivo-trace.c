@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * The Motivo panel trace events live in a module of their own, selected by
+ * both panel drivers, so the two can be built in together. The tables the
+ * drivers share through panel-motivo.h live here too.
+ */
+#include <linux/module.h>
+
+#include "panel-motivo.h"
+
+#define CREATE_TRACE_POINTS
+#include "panel-motivo-trace.h"
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(motivo_panel_begin);
+EXPORT_TRACEPOINT_SYMBOL_GPL(motivo_panel_end);
+EXPORT_TRACEPOINT_SYMBOL_GPL(motivo_panel_dcs_write);
+EXPORT_TRACEPOINT_SYMBOL_GPL(motivo_panel_retry);
+EXPORT_TRACEPOINT_SYMBOL_GPL(motivo_panel_delay);
+
+const u8 motivo_gamma_levels[MOTIVO_GAMMA_TAPS] = {
+	255, 251, 247, 243, 239, 231, 219, 203, 175, 144,
+	111, 80, 52, 36, 24, 16, 12, 8, 4, 0,
+};
+EXPORT_SYMBOL_GPL(motivo_gamma_levels);
+
+MODULE_DESCRIPTION("Motivo panel trace events and shared tables");
+MODULE_LICENSE("GPL");
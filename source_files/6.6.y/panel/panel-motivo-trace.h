@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Trace events of the Motivo panel drivers: panel-dsi-mt and
+ * panel-ilitek-ili9881c. Together they give the bring-up timeline of a
+ * panel: each DRM panel callback, each DCS write with its latency, each
+ * retry and each delay served.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM motivo_panel
+
+#if !defined(_PANEL_MOTIVO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PANEL_MOTIVO_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(motivo_panel_begin,
+	TP_PROTO(struct device *dev, const char *op),
+	TP_ARGS(dev, op),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__string(op, op)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__assign_str(op, op);
+	),
+
+	TP_printk("%s %s", __get_str(dev), __get_str(op))
+);
+
+TRACE_EVENT(motivo_panel_end,
+	TP_PROTO(struct device *dev, const char *op, int ret),
+	TP_ARGS(dev, op, ret),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__string(op, op)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__assign_str(op, op);
+		__entry->ret = ret;
+	),
+
+	TP_printk("%s %s ret=%d", __get_str(dev), __get_str(op), __entry->ret)
+);
+
+TRACE_EVENT(motivo_panel_dcs_write,
+	TP_PROTO(struct device *dev, int page, const u8 *data, size_t len,
+		 s64 latency_ns, int ret),
+	TP_ARGS(dev, page, data, len, latency_ns, ret),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(int, page)
+		__field(u8, reg)
+		__field(size_t, len)
+		__field(s64, latency_ns)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__entry->page = page;
+		__entry->reg = data[0];
+		__entry->len = len;
+		__entry->latency_ns = latency_ns;
+		__entry->ret = ret;
+	),
+
+	TP_printk("%s page=%d reg=0x%02x len=%zu latency=%lld ns ret=%d",
+		  __get_str(dev), __entry->page, __entry->reg, __entry->len,
+		  __entry->latency_ns, __entry->ret)
+);
+
+TRACE_EVENT(motivo_panel_retry,
+	TP_PROTO(struct device *dev, u8 reg, unsigned int attempt,
+		 unsigned int backoff_ms, int err),
+	TP_ARGS(dev, reg, attempt, backoff_ms, err),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u8, reg)
+		__field(unsigned int, attempt)
+		__field(unsigned int, backoff_ms)
+		__field(int, err)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__entry->reg = reg;
+		__entry->attempt = attempt;
+		__entry->backoff_ms = backoff_ms;
+		__entry->err = err;
+	),
+
+	TP_printk("%s reg=0x%02x attempt=%u err=%d backoff=%u ms",
+		  __get_str(dev), __entry->reg, __entry->attempt, __entry->err,
+		  __entry->backoff_ms)
+);
+
+/* @ms of at most @max_ms actually served, the same for a fixed delay */
+TRACE_EVENT(motivo_panel_delay,
+	TP_PROTO(struct device *dev, const char *what, unsigned int ms,
+		 unsigned int max_ms),
+	TP_ARGS(dev, what, ms, max_ms),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__string(what, what)
+		__field(unsigned int, ms)
+		__field(unsigned int, max_ms)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev_name(dev));
+		__assign_str(what, what);
+		__entry->ms = ms;
+		__entry->max_ms = max_ms;
+	),
+
+	TP_printk("%s %s %u of %u ms", __get_str(dev), __get_str(what),
+		  __entry->ms, __entry->max_ms)
+);
+
+#endif /* _PANEL_MOTIVO_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../drivers/gpu/drm/panel
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE panel-motivo-trace
+#include <trace/define_trace.h>
@@ -0,0 +1,355 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Helpers shared by the Motivo panel drivers, panel-dsi-mt and
+ * panel-ilitek-ili9881c. Both drive an ILI9881C, so the link limits, the
+ * extra refresh rates, the pixel format property and the gamma taps are
+ * the same on either side.
+ */
+#ifndef _PANEL_MOTIVO_H
+#define _PANEL_MOTIVO_H
+
+#include <kunit/static_stub.h>
+
+#include <linux/device.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/of.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+
+#include <drm/drm_color_mgmt.h>
+#include <drm/drm_connector.h>
+#include <drm/drm_crtc.h>
+#include <drm/drm_mipi_dsi.h>
+#include <drm/drm_modes.h>
+
+#include "panel-motivo-trace.h"
+
+/* Per lane HS bit rate range of the ILI9881C, in kbps */
+#define MOTIVO_LANE_MIN_KBPS	80000
+#define MOTIVO_LANE_MAX_KBPS	1000000
+
+/* Longest wait a motivo,*-ms timing property can ask for */
+#define MOTIVO_TIMING_MAX_MS	500
+
+/* Page 1 gamma taps, VP255 down to VP0 and VN255 down to VN0 */
+#define MOTIVO_GAMMA_PAGE	1
+#define MOTIVO_GAMMA_POS	0xa0
+#define MOTIVO_GAMMA_NEG	0xc0
+#define MOTIVO_GAMMA_TAPS	20
+
+static inline u64 motivo_lane_kbps(const struct drm_display_mode *mode,
+				   enum mipi_dsi_pixel_format format,
+				   unsigned int lanes)
+{
+	return div_u64((u64)mode->clock * mipi_dsi_pixel_format_to_bpp(format),
+		       lanes);
+}
+
+/*
+ * Add the lower refresh rates of @m: same porches, lower pixel clock, so
+ * the panel needs no new init for them. Rates whose clock would leave the
+ * lane range are skipped. Returns the number of modes added.
+ */
+static inline int motivo_add_low_refresh(struct drm_connector *connector,
+					 const struct drm_display_mode *m,
+					 enum mipi_dsi_pixel_format format,
+					 unsigned int lanes)
+{
+	/* In mHz */
+	static const unsigned int rates[] = { 59940, 50000, 40000, 30000 };
+	struct drm_display_mode *mode;
+	unsigned int i, count = 0;
+	u64 clock;
+
+	for (i = 0; i < ARRAY_SIZE(rates); i++) {
+		clock = DIV_ROUND_CLOSEST_ULL((u64)m->htotal * m->vtotal *
+					      rates[i], 1000000);
+		if (clock >= m->clock)
+			continue;
+
+		mode = drm_mode_duplicate(connector->dev, m);
+		if (!mode)
+			break;
+
+		mode->clock = clock;
+		if (drm_mode_vrefresh(mode) != DIV_ROUND_CLOSEST(rates[i], 1000) ||
+		    motivo_lane_kbps(mode, format, lanes) < MOTIVO_LANE_MIN_KBPS) {
+			drm_mode_destroy(connector->dev, mode);
+			continue;
+		}
+
+		/* The name is all that tells 59.94 Hz from the native 60 */
+		snprintf(mode->name, sizeof(mode->name), "%dx%d@%u.%02u",
+			 mode->hdisplay, mode->vdisplay, rates[i] / 1000,
+			 rates[i] % 1000 / 10);
+		mode->type = DRM_MODE_TYPE_DRIVER;
+		drm_mode_probed_add(connector, mode);
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * "motivo,pixel-format" trades colour depth for DSI bandwidth. Packed
+ * RGB666 sends 4 pixels in 9 bytes, a quarter less than RGB888, and needs
+ * lines of a multiple of 4 pixels. Loose RGB666 keeps 3 bytes a pixel and
+ * only drops the depth. @format is left alone without the property, and
+ * on -EINVAL for a format the link cannot carry.
+ */
+static inline int motivo_parse_format(struct device *dev,
+				      const struct drm_display_mode *mode,
+				      unsigned int lanes,
+				      enum mipi_dsi_pixel_format *format)
+{
+	enum mipi_dsi_pixel_format fmt;
+	const char *name;
+	u64 kbps;
+
+	if (of_property_read_string(dev->of_node, "motivo,pixel-format", &name))
+		return 0;
+
+	if (!strcmp(name, "rgb666-packed")) {
+		fmt = MIPI_DSI_FMT_RGB666_PACKED;
+	} else if (!strcmp(name, "rgb666")) {
+		fmt = MIPI_DSI_FMT_RGB666;
+	} else if (!strcmp(name, "rgb888")) {
+		fmt = MIPI_DSI_FMT_RGB888;
+	} else {
+		dev_err(dev, "unknown pixel format %s\n", name);
+		return -EINVAL;
+	}
+
+	if (fmt == MIPI_DSI_FMT_RGB666_PACKED && mode->hdisplay % 4) {
+		dev_err(dev, "%u pixel lines cannot be sent packed\n",
+			mode->hdisplay);
+		return -EINVAL;
+	}
+
+	kbps = motivo_lane_kbps(mode, fmt, lanes);
+	if (kbps < MOTIVO_LANE_MIN_KBPS || kbps > MOTIVO_LANE_MAX_KBPS) {
+		dev_err(dev, "%s needs %llu kbps per lane, out of range\n",
+			name, kbps);
+		return -EINVAL;
+	}
+
+	dev_info(dev, "%s, %llu kbps per lane\n", name, kbps);
+	*format = fmt;
+
+	return 0;
+}
+
+/*
+ * Read the timing property @prop, @def without it. A value out of
+ * [@min, @max] is clamped: below @min the controller drops commands, above
+ * @max it stalls every modeset for nothing.
+ */
+static inline u32 motivo_read_timing(struct device *dev, const char *prop,
+				     u32 def, u32 min, u32 max)
+{
+	u32 val;
+
+	if (of_property_read_u32(dev->of_node, prop, &val))
+		return def;
+
+	if (val < min || val > max) {
+		dev_warn(dev, "%s of %u is out of the %u..%u range, using %u\n",
+			 prop, val, min, max, clamp(val, min, max));
+		return clamp(val, min, max);
+	}
+
+	return val;
+}
+
+/*
+ * Every delay a driver serves goes through here, @ms of an allowed @max_ms,
+ * so the KUnit suites can count them without tracing.
+ */
+static inline void motivo_trace_delay(struct device *dev, const char *what,
+				      unsigned int ms, unsigned int max_ms)
+{
+	KUNIT_STATIC_STUB_REDIRECT(motivo_trace_delay, dev, what, ms, max_ms);
+
+	trace_motivo_panel_delay(dev, what, ms, max_ms);
+}
+
+/*
+ * Defaults-aware init: with "motivo,prune-defaults" the first init after
+ * boot reads every vendor register before writing it, and the writes that
+ * would leave one unchanged are skipped from then on. "motivo,prune-verify"
+ * reads the registers back after each pruned init; this checks one of them
+ * against what the full table leaves and returns 1 if it differs.
+ */
+static inline unsigned int motivo_prune_check(struct device *dev, u8 page,
+					      u8 reg, int ret, u8 val, u8 want)
+{
+	if (ret < 0) {
+		dev_warn(dev, "prune verify: page %u reg 0x%02x unreadable\n",
+			 page, reg);
+		return 1;
+	}
+
+	if (val != want) {
+		dev_warn(dev, "prune verify: page %u reg 0x%02x is 0x%02x, want 0x%02x\n",
+			 page, reg, val, want);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Returns whether pruning stays on after a verify that found @bad registers */
+static inline bool motivo_prune_done(struct device *dev, unsigned int bad,
+				     unsigned int pruned)
+{
+	if (bad) {
+		dev_warn(dev, "%u registers differ, disabling init pruning\n", bad);
+		return false;
+	}
+
+	dev_info(dev, "pruned init verified, %u writes skipped\n", pruned);
+
+	return true;
+}
+
+/* Index of page 1 register @reg in a 40 tap curve, or -1 if not a tap */
+static inline int motivo_gamma_tap(u8 reg)
+{
+	if (reg >= MOTIVO_GAMMA_POS && reg < MOTIVO_GAMMA_POS + MOTIVO_GAMMA_TAPS)
+		return reg - MOTIVO_GAMMA_POS;
+	if (reg >= MOTIVO_GAMMA_NEG && reg < MOTIVO_GAMMA_NEG + MOTIVO_GAMMA_TAPS)
+		return reg - MOTIVO_GAMMA_NEG + MOTIVO_GAMMA_TAPS;
+
+	return -1;
+}
+
+/*
+ * The gamma sysfs file takes and shows the 40 tap values, the positive
+ * curve from VP255 down to VP0 and then the negative one. 20 values set
+ * both curves alike and "default" goes back to the init table's curve.
+ * Returns 1 for a curve in @gamma, 0 for "default" and -EINVAL otherwise.
+ */
+static inline int motivo_gamma_parse(const char *buf, u8 *gamma)
+{
+	unsigned int n = 0, val;
+	int len;
+
+	if (sysfs_streq(buf, "default"))
+		return 0;
+
+	while (n < 2 * MOTIVO_GAMMA_TAPS && sscanf(buf, "%i%n", &val, &len) == 1) {
+		if (val > U8_MAX)
+			return -EINVAL;
+		gamma[n++] = val;
+		buf += len;
+	}
+	if (*skip_spaces(buf))
+		return -EINVAL;
+
+	if (n == MOTIVO_GAMMA_TAPS)
+		memcpy(&gamma[MOTIVO_GAMMA_TAPS], gamma, MOTIVO_GAMMA_TAPS);
+	else if (n != 2 * MOTIVO_GAMMA_TAPS)
+		return -EINVAL;
+
+	return 1;
+}
+
+static inline int motivo_gamma_show(char *buf, const u8 *gamma)
+{
+	unsigned int i;
+	int len = 0;
+
+	for (i = 0; i < 2 * MOTIVO_GAMMA_TAPS; i++)
+		len += sysfs_emit_at(buf, len, "0x%02x%c", gamma[i],
+				     i % MOTIVO_GAMMA_TAPS == MOTIVO_GAMMA_TAPS - 1 ?
+				     '\n' : ' ');
+
+	return len;
+}
+
+/* Gray level of each tap, VP255 down to VP0, in panel-motivo-trace.c */
+extern const u8 motivo_gamma_levels[MOTIVO_GAMMA_TAPS];
+
+/* The LUT at gray @level, as a gray level in 1/256 steps */
+static inline u32 motivo_lut_at(const struct drm_color_lut *lut, unsigned int n,
+				unsigned int level)
+{
+	u32 pos = level * (n - 1) * 256 / 255;
+	unsigned int i = pos / 256, frac = pos % 256;
+	u32 a, b;
+
+	a = lut[i].red + lut[i].green + lut[i].blue;
+	b = i + 1 < n ? lut[i + 1].red + lut[i + 1].green + lut[i + 1].blue : a;
+
+	return DIV_ROUND_CLOSEST_ULL((u64)(a * (256 - frac) + b * frac) * 255,
+				     3 * 0xffff);
+}
+
+/* The curve of @taps at gray level @t in 1/256 steps, between its taps */
+static inline u8 motivo_gamma_at(const u8 *taps, u32 t)
+{
+	const u8 *lv = motivo_gamma_levels;
+	unsigned int i;
+	int lo, hi;
+
+	for (i = 1; i < MOTIVO_GAMMA_TAPS - 1 && t < lv[i] * 256; i++)
+		;
+
+	lo = lv[i] * 256;
+	hi = lv[i - 1] * 256;
+
+	return taps[i] + DIV_ROUND_CLOSEST((taps[i - 1] - taps[i]) * ((int)t - lo),
+					   hi - lo);
+}
+
+/*
+ * Sample the gamma LUT of the CRTC driving @connector at the gray level of
+ * each tap, into @t in 1/256 gray steps. The connector state is only the
+ * one being committed during the panel callbacks, so this is called from
+ * them and the samples kept. Returns false if the CRTC has no LUT.
+ */
+static inline bool motivo_gamma_sample(struct drm_connector *connector, u32 *t)
+{
+	const struct drm_color_lut *lut;
+	struct drm_crtc *crtc;
+	unsigned int i, n;
+
+	if (!connector || !connector->state)
+		return false;
+
+	crtc = connector->state->crtc;
+	if (!crtc || !crtc->state || !crtc->state->gamma_lut)
+		return false;
+
+	lut = crtc->state->gamma_lut->data;
+	n = drm_color_lut_size(crtc->state->gamma_lut);
+	if (!n)
+		return false;
+
+	for (i = 0; i < MOTIVO_GAMMA_TAPS; i++)
+		t[i] = motivo_lut_at(lut, n, motivo_gamma_levels[i]);
+
+	return true;
+}
+
+/*
+ * Fit the sampled LUT @t to the taps: each tap gets the value @base has at
+ * the gray level the LUT maps the tap's own level to, interpolated between
+ * the neighbouring taps. That is the panel's curve after the LUT, taking
+ * the undocumented tap encoding as monotonic in gray and nothing more, so
+ * it holds whatever curve @base is. The LUT channels are averaged, the
+ * panel has a single curve.
+ */
+static inline void motivo_gamma_fit(const u32 *t, const u8 *base, u8 *gamma)
+{
+	unsigned int i;
+
+	for (i = 0; i < MOTIVO_GAMMA_TAPS; i++) {
+		gamma[i] = motivo_gamma_at(base, t[i]);
+		gamma[MOTIVO_GAMMA_TAPS + i] =
+			motivo_gamma_at(base + MOTIVO_GAMMA_TAPS, t[i]);
+	}
+}
+
+#endif /* _PANEL_MOTIVO_H */